@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""Replay a recorded session into the receiver over USB.
+
+Takes a raw capture written by stream_decode.py --raw and feeds its radio
+frames back to the BOX-3, which handles them exactly like frames arriving
+over the air, on the recording's own clock. Live radio is ignored until
+the replay ends.
+
+    replay.py --port /dev/ttyACM0 --input session.bin             # real time
+    replay.py --port /dev/ttyACM0 --input day.bin --speed 0       # as fast as USB allows
+    replay.py --port /dev/ttyACM0 --input day.bin --speed 0 --capture out.bin
+
+--capture records what the receiver streams back while replaying (link
+up/down, drop counters), for comparing runs with stream_decode.py --input.
+"""
+
+import argparse
+import sys
+import threading
+import time
+import zlib
+
+import stream_decode as sd
+
+STREAM_INJECT = 0x10
+
+
+def inject_record(seq, t_ms, frame):
+    hdr = sd.HDR.pack(sd.SYNC, STREAM_INJECT, len(frame), seq & 0xFFFF, t_ms & 0xFFFFFFFF)
+    return hdr + frame + sd.CRC.pack(zlib.crc32(hdr + frame))
+
+
+def recorded_frames(path):
+    with open(path, "rb") as f:
+        for rtype, _, t_ms, payload in sd.records(f.read):
+            if rtype == sd.STREAM_RX:
+                yield t_ms, payload
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--port", required=True, help="serial port of the BOX-3")
+    ap.add_argument("--input", required=True, help="raw capture from stream_decode.py --raw")
+    ap.add_argument("--speed", type=float, default=1.0,
+                    help="playback speed, e.g. 60 for an hour a minute; 0 for no pacing")
+    ap.add_argument("--capture", help="save the receiver's own stream during the replay")
+    args = ap.parse_args()
+
+    import serial
+    port = serial.Serial(args.port, timeout=0.2, write_timeout=None)
+    stop = threading.Event()
+    reader = None
+    if args.capture:
+        out = open(args.capture, "wb")
+        def drain():
+            while not stop.is_set():
+                out.write(port.read(4096))
+        reader = threading.Thread(target=drain, daemon=True)
+        reader.start()
+        port.write(b"S")
+
+    frames = 0
+    first_t = None
+    started = time.monotonic()
+    try:
+        for seq, (t_ms, frame) in enumerate(recorded_frames(args.input)):
+            if first_t is None:
+                first_t = t_ms
+            if args.speed > 0:
+                due = started + (t_ms - first_t) / 1000.0 / args.speed
+                delay = due - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+            port.write(inject_record(seq, t_ms, frame))
+            frames += 1
+    except KeyboardInterrupt:
+        pass
+    finally:
+        port.write(b"L")
+        port.flush()
+        if reader:
+            time.sleep(0.5)     # Let the last link/stats records arrive
+            port.write(b"X")
+            stop.set()
+            reader.join()
+            out.close()
+        port.close()
+
+    elapsed = time.monotonic() - started
+    if frames:
+        span = (t_ms - first_t) / 1000.0
+        print(f"{frames} frames, {span:.0f} s of recording in {elapsed:.1f} s "
+              f"({frames / elapsed:.0f} frames/s, {span / elapsed:.0f}x)", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
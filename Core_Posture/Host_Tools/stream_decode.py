@@ -0,0 +1,265 @@
+#!/usr/bin/env python3
+"""Decode the receiver's USB stream into CSV.
+
+The BOX-3 writes binary records (see USB STREAM in esp32-s3-box-3.c) once
+the host sends 'S'. Each record becomes one CSV row per posture value, with
+a fixed set of columns so the file loads straight into pandas or converts
+to Parquet without a schema step.
+
+    stream_decode.py --port /dev/ttyACM0 -o session.csv --raw session.bin
+    stream_decode.py --input session.bin -o session.csv
+
+Needs pyserial only when reading from a port.
+"""
+
+import argparse
+import csv
+import struct
+import sys
+import zlib
+
+SYNC = b"\xa5\x5a"
+HDR = struct.Struct("<2sBBHI")     # sync, type, len, seq, t_ms
+CRC = struct.Struct("<I")
+
+STREAM_RX, STREAM_LINK, STREAM_STATS = 0x01, 0x02, 0x03
+PKT_SAMPLE, PKT_EVENT, PKT_HEARTBEAT, PKT_BACKLOG, PKT_OTA_STATUS, PKT_CAPTURE = 1, 2, 3, 4, 5, 6
+PKT_BATCH = 8
+BATCH_HAS_BATTERY, BATCH_HAS_ACTIVITY, BATCH_HAS_TIME = 0x01, 0x02, 0x04
+CAPTURE_RAW, CAPTURE_FILTERED = 1, 2
+
+SAMPLE = struct.Struct("<BBffI")
+EVENT = struct.Struct("<BBBfI")
+HEARTBEAT = struct.Struct("<BBBBffBI")
+BACKLOG_HDR = struct.Struct("<BBHI")
+BACKLOG_REC = struct.Struct("<IhhBB")
+LINK = struct.Struct("<BBB")
+STATS = struct.Struct("<III")
+CAPTURE_HDR = struct.Struct("<BBBHI")   # type, mode, count, rate_hz, first sample
+
+BATTERY_UNKNOWN = 0xFF
+ACTIVITIES = {0: "sitting", 1: "standing", 2: "moving"}
+
+COLUMNS = ["t_ms", "seq", "kind", "state", "pitch", "roll", "battery_pct",
+           "event_seq", "activity", "read_ms", "sender_t_ms", "max_pitch", "slouch_frac",
+           "rx_dropped", "stream_dropped", "stream_sent",
+           "sample", "rate_hz", "ax", "ay", "az", "gx", "gy", "gz"]
+
+
+def records(read):
+    """Yield (type, seq, t_ms, payload) from a read(n) callable.
+
+    Skips anything that is not a valid record, e.g. console log lines
+    sharing the port, by hunting for the sync bytes and checking the CRC.
+    """
+    buf = bytearray()
+    while True:
+        chunk = read(4096)
+        if not chunk:
+            return
+        buf += chunk
+        while True:
+            start = buf.find(SYNC)
+            if start < 0:
+                del buf[:-1]
+                break
+            del buf[:start]
+            if len(buf) < HDR.size:
+                break
+            _, rtype, length, seq, t_ms = HDR.unpack_from(buf)
+            end = HDR.size + length + CRC.size
+            if len(buf) < end:
+                break
+            (crc,) = CRC.unpack_from(buf, HDR.size + length)
+            if zlib.crc32(bytes(buf[:HDR.size + length])) != crc:
+                del buf[:1]     # False sync; look again from the next byte
+                continue
+            yield rtype, seq, t_ms, bytes(buf[HDR.size:HDR.size + length])
+            del buf[:end]
+
+
+def rows(rtype, seq, t_ms, payload):
+    """Turn one record into CSV rows (dicts keyed by COLUMNS)."""
+    base = {"t_ms": t_ms, "seq": seq}
+    if rtype == STREAM_LINK and len(payload) == LINK.size:
+        up, state, bat = LINK.unpack(payload)
+        yield dict(base, kind="link_up" if up else "link_down", state=state,
+                   battery_pct=None if bat == BATTERY_UNKNOWN else bat)
+    elif rtype == STREAM_STATS and len(payload) == STATS.size:
+        rx_drop, st_drop, st_sent = STATS.unpack(payload)
+        yield dict(base, kind="stats", rx_dropped=rx_drop,
+                   stream_dropped=st_drop, stream_sent=st_sent)
+    elif rtype == STREAM_RX and payload:
+        yield from frame_rows(base, payload)
+
+
+def frame_rows(base, data):
+    kind = data[0]
+    if kind == PKT_SAMPLE and len(data) == SAMPLE.size:
+        _, state, pitch, roll, read_ms = SAMPLE.unpack(data)
+        yield dict(base, kind="sample", state=state, pitch=pitch, roll=roll,
+                   read_ms=read_ms or None)
+    elif kind == PKT_HEARTBEAT and len(data) == HEARTBEAT.size:
+        _, state, bat, _, pitch, roll, activity, read_ms = HEARTBEAT.unpack(data)
+        yield dict(base, kind="heartbeat", state=state, pitch=pitch, roll=roll,
+                   battery_pct=None if bat == BATTERY_UNKNOWN else bat,
+                   activity=ACTIVITIES.get(activity, activity), read_ms=read_ms or None)
+    elif kind == PKT_EVENT and len(data) == EVENT.size:
+        _, state, ev_seq, pitch, read_ms = EVENT.unpack(data)
+        yield dict(base, kind="event", state=state, pitch=pitch, event_seq=ev_seq,
+                   read_ms=read_ms or None)
+    elif kind == PKT_BACKLOG and len(data) >= BACKLOG_HDR.size:
+        _, count, _, _ = BACKLOG_HDR.unpack_from(data)
+        if len(data) != BACKLOG_HDR.size + count * BACKLOG_REC.size:
+            return
+        for i in range(count):
+            t, pitch_dd, roll_dd, max_pitch, frac = BACKLOG_REC.unpack_from(
+                data, BACKLOG_HDR.size + i * BACKLOG_REC.size)
+            yield dict(base, kind="backlog", pitch=pitch_dd / 10.0, roll=roll_dd / 10.0,
+                       sender_t_ms=t, max_pitch=max_pitch, slouch_frac=frac / 255.0)
+    elif kind == PKT_CAPTURE and len(data) >= CAPTURE_HDR.size:
+        yield from capture_rows(base, data)
+    elif kind == PKT_BATCH:
+        yield from batch_rows(base, data)
+    # OTA status and unknown frames carry no posture data
+
+
+def varint(data, pos):
+    """Decode one LEB128 varint; returns (value, next pos)."""
+    value = shift = 0
+    while True:
+        b = data[pos]
+        value |= (b & 0x7F) << shift
+        pos += 1
+        if not b & 0x80:
+            return value, pos
+        shift += 7
+
+
+def batch_decode(data):
+    """PKT_BATCH -> (state, battery_pct, activity, t_ms, [(at_ms, pitch, roll)]).
+
+    Layout is documented next to PKT_BATCH in esp32-c3-mini.c. Raises
+    ValueError on a frame that is short or has bytes left over.
+    """
+    try:
+        _, flags, count, state = struct.unpack_from("<BBBB", data)
+        pos = 4
+        battery = activity = t_ms = None
+        if flags & BATCH_HAS_BATTERY:
+            battery, pos = data[pos], pos + 1
+        if flags & BATCH_HAS_ACTIVITY:
+            activity, pos = data[pos], pos + 1
+        if flags & BATCH_HAS_TIME:
+            (t_ms,), pos = struct.unpack_from("<I", data, pos), pos + 4
+        p, r = struct.unpack_from("<hh", data, pos)
+        pos += 4
+        at, samples = 0, [(0, p, r)]
+        for _ in range(count - 1):
+            dt, pos = varint(data, pos)
+            dp, pos = varint(data, pos)
+            dr, pos = varint(data, pos)
+            at += dt
+            p += (dp >> 1) ^ -(dp & 1)
+            r += (dr >> 1) ^ -(dr & 1)
+            samples.append((at, p, r))
+    except (IndexError, struct.error):
+        raise ValueError("truncated batch")
+    if not count or pos != len(data):
+        raise ValueError("malformed batch")
+    return state, battery, activity, t_ms, [(a, p / 10.0, r / 10.0) for a, p, r in samples]
+
+
+def batch_rows(base, data):
+    """One row per batched sample. The newest arrived at t_ms, the rest are
+    placed before it by their recorded spacing."""
+    try:
+        state, battery, activity, t0, samples = batch_decode(data)
+    except ValueError:
+        return
+    span = samples[-1][0]
+    for at, pitch, roll in samples:
+        row = dict(base, kind="batch", state=state, pitch=pitch, roll=roll,
+                   t_ms=base["t_ms"] - span + at, read_ms=t0 + at if t0 else None)
+        if at == 0:
+            row.update(battery_pct=None if battery in (None, BATTERY_UNKNOWN) else battery,
+                       activity=None if activity is None else ACTIVITIES.get(activity, activity))
+        yield row
+
+
+def capture_rows(base, data):
+    """One row per research capture sample; sample / rate_hz is its time."""
+    _, mode, count, rate, first = CAPTURE_HDR.unpack_from(data)
+    words = 6 if mode == CAPTURE_RAW else 2
+    if mode not in (CAPTURE_RAW, CAPTURE_FILTERED) or len(data) != CAPTURE_HDR.size + count * words * 2:
+        return
+    values = struct.unpack_from(f"<{count * words}h", data, CAPTURE_HDR.size)
+    for i in range(count):
+        v = values[i * words:(i + 1) * words]
+        row = dict(base, sample=first + i, rate_hz=rate)
+        if mode == CAPTURE_RAW:
+            row.update(kind="raw", ax=v[0], ay=v[1], az=v[2], gx=v[3], gy=v[4], gz=v[5])
+        else:
+            row.update(kind="filtered", pitch=v[0] / 100.0, roll=v[1] / 100.0)
+        yield row
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    src = ap.add_mutually_exclusive_group(required=True)
+    src.add_argument("--port", help="serial port of the BOX-3, e.g. /dev/ttyACM0 or COM5")
+    src.add_argument("--input", help="raw capture written earlier with --raw")
+    ap.add_argument("-o", "--output", help="CSV file (default: stdout)")
+    ap.add_argument("--raw", help="also save the undecoded bytes here")
+    args = ap.parse_args()
+
+    if args.port:
+        import serial
+        port = serial.Serial(args.port, timeout=0.5)
+        port.write(b"S")
+        def read(n):
+            # Keep going through idle periods; only Ctrl-C ends a live capture
+            while True:
+                data = port.read(n)
+                if data:
+                    return data
+        close = lambda: (port.write(b"X"), port.close())
+    else:
+        f = open(args.input, "rb")
+        read, close = f.read, f.close
+
+    raw = open(args.raw, "wb") if args.raw else None
+    if raw:
+        inner = read
+        def read(n):
+            data = inner(n)
+            raw.write(data)
+            return data
+
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+    writer = csv.DictWriter(out, fieldnames=COLUMNS)
+    writer.writeheader()
+    last_seq = None
+    gaps = 0
+    try:
+        for rec in records(read):
+            seq = rec[1]
+            if last_seq is not None and seq != (last_seq + 1) & 0xFFFF:
+                gaps += 1
+            last_seq = seq
+            for row in rows(*rec):
+                writer.writerow(row)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        close()
+        if raw:
+            raw.close()
+        if out is not sys.stdout:
+            out.close()
+    if gaps:
+        print(f"{gaps} gap(s) in the record sequence", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
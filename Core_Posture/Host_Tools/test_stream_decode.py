@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+"""Unit tests for stream_decode.py's PKT_BATCH decoder.
+
+    python3 -m unittest discover Core_Posture/Host_Tools
+"""
+
+import os
+import sys
+import unittest
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+import stream_decode  # noqa: E402
+
+# Three samples, battery and shared-clock time present, activity absent:
+#   type, flags, count, state, battery, t_ms, pitch/roll of the first sample,
+#   then (dt, zigzag pitch delta, zigzag roll delta) varints per sample.
+BATCH = bytes([
+    stream_decode.PKT_BATCH,
+    stream_decode.BATCH_HAS_BATTERY | stream_decode.BATCH_HAS_TIME,
+    3, 1,
+    80,
+    0xE8, 0x03, 0x00, 0x00,     # t_ms 1000
+    0x96, 0x00, 0xEC, 0xFF,     # 15.0, -2.0 deg
+    0x64, 0x06, 0x01,           # +100 ms, +0.3, -0.1
+    0xC8, 0x01, 0x8B, 0x01, 0x00,   # +200 ms, -7.0, 0
+])
+
+
+class BatchDecodeTest(unittest.TestCase):
+    def test_known_vector(self):
+        state, battery, activity, t_ms, samples = stream_decode.batch_decode(BATCH)
+        self.assertEqual((state, battery, activity, t_ms), (1, 80, None, 1000))
+        self.assertEqual([at for at, _, _ in samples], [0, 100, 300])
+        want = [(15.0, -2.0), (15.3, -2.1), (8.3, -2.1)]
+        for (_, pitch, roll), (want_pitch, want_roll) in zip(samples, want):
+            self.assertAlmostEqual(pitch, want_pitch)
+            self.assertAlmostEqual(roll, want_roll)
+
+    def test_truncated(self):
+        for n in (3, 6, len(BATCH) - 1):
+            with self.assertRaisesRegex(ValueError, "truncated"):
+                stream_decode.batch_decode(BATCH[:n])
+
+    def test_leftover_bytes(self):
+        with self.assertRaisesRegex(ValueError, "malformed"):
+            stream_decode.batch_decode(BATCH + b"\x00")
+
+    def test_empty_batch(self):
+        with self.assertRaisesRegex(ValueError, "malformed"):
+            stream_decode.batch_decode(BATCH[:2] + b"\x00" + BATCH[3:13])
+
+
+if __name__ == "__main__":
+    unittest.main()
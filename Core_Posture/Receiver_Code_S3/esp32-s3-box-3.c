@@ -6,7 +6,10 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
 #include <math.h> 
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
@@ -15,8 +18,16 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_now.h"
+#include "esp_timer.h"
 #include "esp_crc.h"
+#include "esp_heap_caps.h"
+#include "esp_cpu.h"
+#include "esp_partition.h"
+#include "driver/usb_serial_jtag.h"
+#include "esp_vfs_usb_serial_jtag.h"
+#include "mbedtls/sha256.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 #include "lvgl.h"
 #include "bsp/esp-bsp.h"
 
@@ -33,73 +44,1737 @@
 #define COLOR_TANK_BG     lv_color_hex(0x0A121E)
 
 // --- PACKETS ---
-typedef struct {
+#define BATTERY_UNKNOWN 0xFF
+
+// Sender -> receiver frames start with a type byte and end in a 2-byte
+// per-sender sequence number, stripped on arrival. They are broadcast,
+// apart from OTA status during a transfer; everything we send the wearable
+// is addressed to it alone. Each side parses only its own direction, and a
+// type never shares its length with a CMD_* of the same value.
+#define PKT_SAMPLE         0x01
+#define PKT_EVENT          0x02
+#define PKT_HEARTBEAT      0x03
+#define PKT_BACKLOG        0x04
+#define PKT_OTA_STATUS     0x05
+#define PKT_CAPTURE        0x06    // capture_frame_t, passed through to the USB stream
+#define PKT_BATCH          0x08    // Delta-coded samples, see below
+#define PKT_RELAY          0x09    // relay_frame_t, from another receiver
+#define PKT_TIME_REQ       0x40    // time_req_t, answered with CMD_TIME_SYNC
+
+typedef enum {
+    POSTURE_GOOD = 0,
+    POSTURE_SLOUCH = 1,
+} posture_state_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;          // PKT_SAMPLE
+    uint8_t state;         // posture_state_t decided by the sender
     float pitch;
     float roll;
-    int battery_level;
+    uint32_t t_ms;         // Reading time in our uptime (sender's TIME SYNC), 0 if not synced yet
 } posture_packet_t;
 
+typedef struct __attribute__((packed)) {
+    uint8_t type;          // PKT_HEARTBEAT
+    uint8_t state;
+    uint8_t battery_pct;   // 0-100, BATTERY_UNKNOWN if not measured
+    uint8_t hb_interval_ds;// Longest silence to expect, 100 ms units; 0 while streaming
+    float pitch;
+    float roll;
+    uint8_t activity;      // ACT_*, the sender's own motion classification
+    uint32_t t_ms;         // As in posture_packet_t
+} heartbeat_packet_t;
+
+// PKT_BATCH (TX_POLICY_BATCH), byte stream rather than a struct:
+//   type, flags (BATCH_HAS_*), count, state
+//   battery_pct            if BATCH_HAS_BATTERY (changed since the last batch)
+//   activity               if BATCH_HAS_ACTIVITY (likewise)
+//   t_ms, uint32 LE        if BATCH_HAS_TIME: shared clock of the first sample
+//   pitch, roll            int16 LE, 0.1 deg: the keyframe
+//   per further sample:    varint dt_ms, zigzag varint d_pitch, zigzag varint d_roll
+#define BATCH_HAS_BATTERY  0x01
+#define BATCH_HAS_ACTIVITY 0x02
+#define BATCH_HAS_TIME     0x04
+#define BATCH_MIN_LEN      8
+#define BATCH_MAX_SAMPLES  ((ESP_NOW_MAX_DATA_LEN - BATCH_MIN_LEN) / 3 + 1)
+
+typedef struct {
+    uint8_t flags, count, state, battery_pct, activity;
+    uint32_t t_ms;
+    uint32_t at_ms[BATCH_MAX_SAMPLES];     // After the first sample
+    int16_t pitch_dd[BATCH_MAX_SAMPLES];
+    int16_t roll_dd[BATCH_MAX_SAMPLES];
+} batch_t;
+
+// While the sender says ACT_MOVING it pauses slouch detection and samples
+#define ACT_SITTING        0
+#define ACT_STANDING       1
+#define ACT_MOVING         2
+
+// 5 s aggregate the sender buffered while we were out of range
+typedef struct __attribute__((packed)) {
+    uint32_t t_ms;         // Sender uptime at the end of the period
+    int16_t pitch_dd;      // Mean pitch, 0.1 deg
+    int16_t roll_dd;       // Mean roll, 0.1 deg
+    uint8_t max_pitch;     // Peak |pitch|, whole degrees
+    uint8_t slouch_frac;   // Share of the period spent slouching, 0-255
+} backlog_rec_t;
+
+#define BACKLOG_PER_FRAME  24
+#define BACKLOG_PERIOD_S   5
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;          // PKT_BACKLOG
+    uint8_t count;
+    uint16_t seq;
+    uint32_t now_ms;       // Sender uptime at send, to rebase t_ms
+    backlog_rec_t rec[BACKLOG_PER_FRAME];
+} backlog_frame_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;          // PKT_EVENT
+    uint8_t state;         // New posture_state_t
+    uint8_t seq;           // Increments per transition
+    float pitch;
+    uint32_t t_ms;         // As in posture_packet_t
+} posture_event_t;
+
+// Receiver -> sender commands
+#define CMD_CALIBRATE      1
+#define CMD_VIBRATION      2   // value: 0/1
+#define CMD_SET_ENTER_DEG  3   // value: degrees
+#define CMD_SET_EXIT_DEG   4   // value: degrees
+#define CMD_SET_DWELL      5   // value: 100 ms units
+#define CMD_SET_COOLDOWN   6   // value: seconds
+#define CMD_SET_TX_POLICY  7   // value: TX_POLICY_*
+#define CMD_SET_TX_DELTA   8   // value: 0.1 deg units
+#define CMD_HEARTBEAT_ACK  9
+#define CMD_BACKLOG_ACK    10  // backlog_ack_t
+#define CMD_OTA_BEGIN      11  // ota_begin_t
+#define CMD_OTA_DATA       12  // ota_chunk_t
+#define CMD_OTA_END        13  // Verify, switch partitions, reboot
+#define CMD_OTA_ABORT      14
+#define CMD_CAPTURE        15  // value: CAPTURE_*
+#define CMD_CAPTURE_ODR    16  // value: MPU sample rate, 10 Hz units
+#define CMD_CAPTURE_DECIM  17  // value: decimation factor in filtered mode
+#define CMD_TIME_SYNC      18  // time_sync_t
+
+#define TX_POLICY_STREAM   0
+#define TX_POLICY_EVENT    1
+#define TX_POLICY_BATCH    2
+
 typedef struct {
     uint8_t command_id; 
     uint8_t value;      
 } command_packet_t;
 
+typedef struct __attribute__((packed)) {
+    uint8_t command_id;    // CMD_BACKLOG_ACK
+    uint8_t value;         // Unused
+    uint16_t seq;
+} backlog_ack_t;
+
+// Time sync: the sender keeps its readings on our uptime by timing an
+// exchange now and then. We only report when its request got here.
+typedef struct __attribute__((packed)) {
+    uint8_t type;          // PKT_TIME_REQ
+    uint8_t seq;
+} time_req_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t command_id;    // CMD_TIME_SYNC
+    uint8_t seq;           // From the request
+    int64_t rx_us;         // Our uptime when the request arrived
+    uint32_t hold_us;      // Arrival to this reply
+} time_sync_t;
+
+#define SYNC_MAX_LATENCY_MS 1000    // Reading to arrival; beyond this the stamp is not trusted
+#define SYNC_LOG_MS         60000
+
+// Receiver -> receiver: a wearable's frame passed on by a relay (see RELAY).
+// The wearable keeps its relayable frames within the payload.
+typedef struct __attribute__((packed)) {
+    uint8_t type;          // PKT_RELAY
+    uint8_t hops;          // Relays passed so far
+    uint8_t dest[6];       // Home receiver; broadcast mirrors on every display
+    uint8_t src[6];        // The wearable
+    uint16_t seq;          // Its frame sequence number
+    uint8_t data[ESP_NOW_MAX_DATA_LEN - 16];
+} relay_frame_t;
+
+// --- SENDER OTA ---
+// The sender image is flashed into a data partition on this box and pushed
+// from there. See README for the partition layout on both devices.
+#define OTA_PARTITION_LABEL "sndfw"
+#define OTA_IMAGE_CHIP_ID   0x0005  // ESP32-C3, from the app image header
+#define OTA_CHUNK           192     // Image bytes per frame, matches the sender
+#define OTA_WINDOW          32      // Chunks past the sender's base kept in flight
+#define OTA_RTO_MS          50      // Resend an unacked chunk after this long
+#define OTA_BEGIN_MS        3000    // Wait this long for the sender to answer
+#define OTA_STALL_MS        5000    // Give up if the base stops moving; it resumes later
+#define OTA_DONE_MS         5000    // Sender hashes the image before answering END
+#define OTA_PHY_RATE        WIFI_PHY_RATE_24M   // ESP-NOW rate during the transfer
+
+typedef struct __attribute__((packed)) {
+    uint8_t command_id;    // CMD_OTA_BEGIN
+    uint8_t value;         // Unused
+    uint32_t size;         // Image bytes
+    uint8_t sha256[32];    // Over the whole image, checked before switching
+} ota_begin_t;
+
+// Sent with only len bytes of data
+typedef struct __attribute__((packed)) {
+    uint8_t command_id;    // CMD_OTA_DATA
+    uint8_t len;
+    uint16_t index;        // Chunk number, byte offset = index * OTA_CHUNK
+    uint32_t crc;          // esp_crc32_le over data
+    uint8_t data[OTA_CHUNK];
+} ota_chunk_t;
+
+#define OTA_ST_IDLE        0
+#define OTA_ST_RECEIVING   1
+#define OTA_ST_DONE        2       // Verified, rebooting into the new image
+#define OTA_ST_ERROR       3
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;          // PKT_OTA_STATUS
+    uint8_t status;        // OTA_ST_*
+    uint16_t base;         // Every chunk below this is written
+    uint32_t sack;         // Bit i: chunk base + 1 + i written
+} ota_status_t;
+
+// Research capture from the sender: full-rate raw IMU samples or decimated
+// orientation, for the host to log over USB. Not shown on screen.
+#define CAPTURE_OFF        0
+#define CAPTURE_RAW        1       // data: ax, ay, az, gx, gy, gz per sample, raw counts
+#define CAPTURE_FILTERED   2       // data: pitch, roll per sample, 0.01 deg
+#define CAPTURE_WORDS      118
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;          // PKT_CAPTURE
+    uint8_t mode;
+    uint8_t count;         // Samples in data
+    uint16_t rate_hz;
+    uint32_t sample;       // Index of the first sample since the capture started
+    int16_t data[CAPTURE_WORDS];
+} capture_frame_t;
+
 uint8_t BROADCAST_MAC[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 
 // --- GLOBAL STATE ---
 static int water_count = 0;           
-static QueueHandle_t posture_queue;
-static uint32_t last_packet_tick = 0; 
+static QueueHandle_t cmd_queue;            // UI -> radio core commands
 #define CONNECTION_TIMEOUT_MS 3000
+// Event mode: declare loss after this many silent heartbeats plus the slack,
+// the sender's LINK_LOSS_MS. Both sides then agree on when live data stopped
+// and its backlog took over.
+#define HEARTBEAT_MISSES      2
+#define HEARTBEAT_SLACK_MS    1000
+// One wearable per display. Broadcast pairs with the first one heard and
+// keeps it until it has been quiet for a link timeout; set a wearable's
+// Wi-Fi MAC to only ever show that one.
+#define SENDER_MAC            { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }
+
+// --- CORE PARTITIONING ---
+// Core 0 runs the Wi-Fi stack, so radio ingestion, link state, history and
+// NVS writes live there too. Core 1 runs only the LVGL task. Data crosses
+// between them through the lock-free structures in CORE HANDOFF; neither
+// side ever blocks on the other.
+#define RADIO_CORE        0
+#define UI_CORE           1
+#define RX_RING_SLOTS     32
+#define INGEST_PERIOD_MS  100   // Housekeeping tick when no frames arrive
+
+// --- RELAY ---
+// A BOX-3 in range of the wearable can pass its frames on to one that is
+// not. Relays forward the paired wearable's frames (see SENDER_MAC) and
+// other relays' frames up to RELAY_MAX_HOPS. Every box drops copies it has
+// seen within RELAY_DEDUP_MS, keyed by wearable MAC and frame sequence
+// number, and shows frames addressed to it or to broadcast. A relay never
+// acks or configures the wearable; only its home box does.
+#define RELAY_ENABLED       0
+#define RELAY_HOME_MAC      { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }     // Broadcast: every display mirrors
+#define RELAY_MAX_HOPS      2
+#define RELAY_DEDUP_SLOTS   64      // Power of two
+#define RELAY_DEDUP_PROBES  8
+#define RELAY_DEDUP_MS      1000
+#define RELAY_LOG_MS        60000
+
+// --- USB STREAM ---
+// Raw frames out of the BOX-3's USB port for logging on a PC. Silent until
+// the host sends STREAM_CMD_START; decode with Host_Tools/stream_decode.py.
+// The same port takes recorded frames back in for replay (Host_Tools/replay.py).
+#define USB_STREAM_ENABLED  1
+#define USB_STREAM_TX_BUF   8192    // Driver ring; frames that do not fit are dropped
+#define USB_STREAM_RX_BUF   4096    // Replay input; a full ring stalls the host, not us
+#define USB_STREAM_STATS_MS 1000
+#define REPLAY_IDLE_MS      5000    // Back to live radio if the host goes quiet
+
+// --- DISPLAY PIPELINE ---
+// Partial refresh into DMA-capable draw buffers. With two buffers LVGL renders
+// the next band while the previous one is still going out over SPI. PSRAM
+// buffers allow more lines but SPI has to bounce them through internal RAM.
+// Long-press the header to run the benchmark and compare settings.
+#define DISPLAY_BUF_LINES   40      // Draw buffer height, x BSP_LCD_H_RES px
+#define DISPLAY_DOUBLE_BUF  1
+#define DISPLAY_BUF_PSRAM   0       // 0: internal RAM, 1: PSRAM
+#define DISPLAY_BENCH_MS    10000
+#define DISPLAY_BENCH_STEP  500     // Tab fade every step
+
+// --- DISPLAY POWER ---
+// With no touch and no frame from the sender the backlight dims, then goes
+// off with the UI loop and LVGL refresh paused. The off delay is picked
+// under Settings > Screen Off.
+#define DISPLAY_BRIGHT_PCT  100
+#define DISPLAY_DIM_PCT     20
+#define DISPLAY_DIM_S       30
+#define DISPLAY_OFF_MIN     5       // Default, 0 = never
+#define DISPLAY_POLL_MS     100     // Also the wake latency for a frame from the sender
+#define UI_LOOP_MS          30
+
+// --- MEMORY DIAGNOSTICS ---
+// Boxes run for weeks; slow leaks and fragmentation show up here first.
+#define DIAG_SAMPLE_MS      5000
+#define DIAG_LOG_MS         60000
+#define DIAG_TIMER_SLACK    8       // LVGL timers allowed above the boot count
+
+// --- PROFILER ---
+#define PROFILE_ENABLED     0       // 1: time hot paths, dump over serial and on the diag tab
+#define PROFILE_DUMP_MS     30000
+#define PROF_MAX_TASKS      24
+
+// --- SENDER SETTINGS (per user, pushed to the sender) ---
+#define DET_DEFAULT_ENTER_DEG   15
+#define DET_HYSTERESIS_DEG      3     // exit threshold = enter - hysteresis
+#define DET_DEFAULT_DWELL_DS    10    // 1.0 s
+#define DET_DEFAULT_COOLDOWN_S  10
+#define TX_DEFAULT_DELTA_DD     20    // 2.0 deg
 
-static float current_pitch = 0;
+typedef struct {
+    uint8_t enter_deg;
+    uint8_t exit_deg;
+    uint8_t dwell_ds;      // 100 ms units
+    uint8_t cooldown_s;
+    uint8_t tx_policy;     // TX_POLICY_*
+    uint8_t tx_delta_dd;   // 0.1 deg units
+} sender_settings_t;
+
+static sender_settings_t sender_cfg = {
+    DET_DEFAULT_ENTER_DEG, DET_DEFAULT_ENTER_DEG - DET_HYSTERESIS_DEG,
+    DET_DEFAULT_DWELL_DS, DET_DEFAULT_COOLDOWN_S,
+    TX_POLICY_EVENT, TX_DEFAULT_DELTA_DD,
+};
+static atomic_bool sender_cfg_dirty;   // UI edited sender_cfg; radio core saves and pushes
+static uint8_t screen_off_min = DISPLAY_OFF_MIN;
+static atomic_bool display_cfg_dirty;  // UI changed screen_off_min; radio core saves it
+static posture_state_t shown_state = POSTURE_GOOD;
+
+// Header text is repainted only when this changes
+typedef enum { HEADER_WAITING, HEADER_SEARCHING, HEADER_WATER, HEADER_SLOUCH, HEADER_GOOD } header_t;
+static header_t shown_header = HEADER_WAITING;
 
 // --- WATER REMINDER VARS ---
-static int water_timer_ticks = 0;
-// 30ms per tick. 120,000 ticks = 60 mins.
-#define WATER_REMINDER_THRESHOLD  120000 
+// Kept on the clock, not in UI loop ticks, so it runs on while the screen is off
+#define WATER_REMINDER_MS  (60 * 60 * 1000)
+static int64_t water_due_ms = WATER_REMINDER_MS;
 static bool water_alert_active = false;
 
 // --- UI Objects ---
 static lv_obj_t *scr;
-static lv_obj_t *panel_home, *panel_stats, *panel_settings;
-static lv_obj_t *nav_labels[3]; 
+#define TAB_COUNT 4
+static lv_obj_t *panel_home, *panel_stats, *panel_settings, *panel_diag;
+static lv_obj_t *nav_labels[TAB_COUNT]; 
 static lv_obj_t *label_wifi_icon;
+static lv_obj_t *label_battery;
 static lv_obj_t *label_posture_status; // Header
 static lv_obj_t *spine_track, *posture_dot;
 static lv_obj_t *label_pitch_val;
 static lv_obj_t *water_bar, *label_water_pct, *label_water_timer;
-static lv_obj_t *chart_posture;
-static lv_chart_series_t *ser_posture;
+static lv_obj_t *chart_posture, *label_chart_title;
+static lv_obj_t *label_summary;
 static lv_obj_t *sw_vibration, *sw_wifi, *lbl_wifi_status;
 static lv_obj_t *btn_cal, *lbl_cal; 
+static lv_obj_t *slider_angle, *lbl_angle_val;
+static lv_obj_t *lbl_tx_policy;
+static lv_obj_t *btn_ota, *lbl_ota;
+static lv_obj_t *lbl_capture;
+static lv_obj_t *label_diag, *label_prof;
+// Kept outside the widgets so the settings tab can be freed and rebuilt
+static bool vibration_on = true, radio_on = true;
+static uint8_t capture_mode = CAPTURE_OFF;
+
+// --- DISPLAY BENCHMARK ---
+static struct {
+    bool running;
+    int64_t start_us;
+    int tab;
+    uint32_t frames;       // Refresh cycles reported by monitor_cb
+    uint32_t time_ms;      // Render + flush time summed over them
+    uint32_t max_ms;
+    uint32_t px;
+} bench;
+
+// ======================= BOOT PROFILE =======================
+
+// Logs how long a boot phase took and when it ended, both from esp_timer,
+// which starts counting just before app_main. Safe from either core.
+static int64_t boot_phase(const char * name, int64_t since_us) {
+    int64_t now = esp_timer_get_time();
+    ESP_LOGI("BOOT", "%-14s +%4ld ms  (t=%ld ms)", name, (long)((now - since_us) / 1000), (long)(now / 1000));
+    return now;
+}
+
+// ======================= PROFILER =======================
+// Scoped cycle-counter timers feeding min/avg/max/p99 histograms, plus the
+// FreeRTOS per-task CPU table. With PROFILE_ENABLED 0 the macros below
+// expand to nothing and none of this is compiled.
+typedef enum {
+    PROF_UI_LOOP,          // update_loop, UI core
+    PROF_RENDER,           // LVGL render + flush per refresh, ms resolution
+    PROF_CHART,            // refresh_chart, UI core
+    PROF_DIAG,             // diag_sample_cb, UI core
+    PROF_FRAME,            // handle_frame, radio core
+    PROF_HISTORY,          // history_export_chart, radio core
+    PROF_ANALYTICS,        // analytics_sample, radio core
+    PROF_SLOTS
+} prof_slot_t;
+
+#if PROFILE_ENABLED
+static const char * PROF_NAMES[PROF_SLOTS] = { "ui_loop", "render", "chart", "diag", "frame", "history", "analytics" };
+
+#define PROF_BUCKETS       40      // Two per octave, 1 us up to ~1 s
+#define PROF_CPU_MHZ       CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t hist[PROF_BUCKETS];
+} prof_stat_t;
+
+// Each slot is written by one task only. A dump may catch a slot halfway
+// through an update, which is acceptable for a diagnostic.
+static prof_stat_t prof[PROF_SLOTS];
+
+// Log-linear buckets: 0 and 1 us, then two per power of two
+static int prof_bucket(uint32_t us) {
+    if (us < 2) return us;
+    int msb = 31 - __builtin_clz(us);
+    int b = msb * 2 + ((us >> (msb - 1)) & 1);
+    return b < PROF_BUCKETS ? b : PROF_BUCKETS - 1;
+}
+
+// Lowest value that falls in the next bucket
+static uint32_t prof_bucket_top(int b) {
+    b++;
+    if (b < 2) return b;
+    int msb = b / 2;
+    return (1u << msb) + (b & 1) * (1u << (msb - 1));
+}
+
+static void prof_record(int slot, uint32_t us) {
+    prof_stat_t *p = &prof[slot];
+    if (p->count == 0 || us < p->min_us) p->min_us = us;
+    if (us > p->max_us) p->max_us = us;
+    p->count++;
+    p->total_us += us;
+    p->hist[prof_bucket(us)]++;
+}
+
+// Upper bound of the bucket holding the pct-th percentile
+static uint32_t prof_percentile(const prof_stat_t *p, uint32_t pct) {
+    uint32_t want = ((uint64_t)p->count * pct + 99) / 100, seen = 0;
+    for (int b = 0; b < PROF_BUCKETS; b++) {
+        seen += p->hist[b];
+        if (seen >= want) {
+            uint32_t top = prof_bucket_top(b);
+            return top < p->max_us ? top : p->max_us;
+        }
+    }
+    return p->max_us;
+}
+
+typedef struct {
+    int slot;
+    uint32_t start;
+} prof_scope_t;
+
+static inline void prof_scope_end(prof_scope_t *sc) {
+    prof_record(sc->slot, (esp_cpu_get_cycle_count() - sc->start) / PROF_CPU_MHZ);
+}
+
+// Times the rest of the enclosing block, including early returns
+#define PROF_SCOPE(slot) \
+    prof_scope_t __attribute__((cleanup(prof_scope_end))) prof_scope_##slot = { slot, esp_cpu_get_cycle_count() }
+
+// CPU share of each task since boot, as a percentage of one core.
+// Needs FreeRTOS run-time stats and the trace facility in menuconfig.
+static int prof_task_stats(char *buf, int len) {
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_USE_TRACE_FACILITY
+    static TaskStatus_t ts[PROF_MAX_TASKS];
+    configRUN_TIME_COUNTER_TYPE total;
+    UBaseType_t n = uxTaskGetSystemState(ts, PROF_MAX_TASKS, &total);
+    int used = 0;
+    for (UBaseType_t i = 0; i < n && total > 0 && used < len; i++) {
+        used += snprintf(buf + used, len - used, "%-12s %3lu%%\n", ts[i].pcTaskName,
+                         (unsigned long)((uint64_t)ts[i].ulRunTimeCounter * 100 / total));
+    }
+    return used < len ? used : len - 1;
+#else
+    return snprintf(buf, len, "(enable FreeRTOS run-time stats)\n");
+#endif
+}
+
+// One line per slot seen this window: count, avg / p99 / max in us
+static int prof_format(char *buf, int len) {
+    int used = 0;
+    for (int i = 0; i < PROF_SLOTS && used < len; i++) {
+        prof_stat_t *p = &prof[i];
+        if (!p->count) continue;
+        used += snprintf(buf + used, len - used, "%-10s n=%lu %lu/%lu/%lu us\n", PROF_NAMES[i],
+                         (unsigned long)p->count, (unsigned long)(p->total_us / p->count),
+                         (unsigned long)prof_percentile(p, 99), (unsigned long)p->max_us);
+    }
+    if (used == 0) used = snprintf(buf, len, "(no samples yet)\n");
+    return used < len ? used : len - 1;
+}
+
+// Every PROFILE_DUMP_MS: log the window (avg/p99/max) and the task table,
+// then start a new window.
+static void prof_poll(int64_t now_ms) {
+    static int64_t last_ms = 0;
+    static char buf[PROF_MAX_TASKS * 24];
+    if (now_ms - last_ms < PROFILE_DUMP_MS) return;
+    last_ms = now_ms;
+
+    prof_format(buf, sizeof(buf));
+    ESP_LOGI("PROF", "Last %d s, avg/p99/max:\n%s", PROFILE_DUMP_MS / 1000, buf);
+    prof_task_stats(buf, sizeof(buf));
+    ESP_LOGI("PROF", "CPU per task:\n%s", buf);
+    memset(prof, 0, sizeof(prof));
+}
+#else
+#define PROF_SCOPE(slot)       ((void)0)
+#define prof_record(slot, us)  ((void)0)
+#define prof_poll(now_ms)      ((void)0)
+#endif
+
+// ======================= CORE HANDOFF =======================
+
+// Single-producer/single-consumer ring indices. Slots live in the caller's
+// array; head and tail only ever grow, so full/empty need no extra flag.
+typedef struct {
+    atomic_uint head;
+    atomic_uint tail;
+} spsc_t;
+
+// Slot to fill, or -1 if full. Producer side only.
+static inline int spsc_reserve(spsc_t * q, unsigned cap) {
+    unsigned head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&q->tail, memory_order_acquire) >= cap) return -1;
+    return head % cap;
+}
+
+static inline void spsc_publish(spsc_t * q) {
+    atomic_fetch_add_explicit(&q->head, 1, memory_order_release);
+}
+
+// Slot to read, or -1 if empty. Consumer side only.
+static inline int spsc_peek(spsc_t * q, unsigned cap) {
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&q->head, memory_order_acquire)) return -1;
+    return tail % cap;
+}
+
+static inline void spsc_consume(spsc_t * q) {
+    atomic_fetch_add_explicit(&q->tail, 1, memory_order_release);
+}
+
+// Seqlock for state published by the radio core: the writer never waits,
+// readers retry if a write overlapped their copy.
+typedef struct {
+    atomic_uint seq;
+} seqlock_t;
+
+static inline void seq_write_begin(seqlock_t * l) {
+    atomic_fetch_add_explicit(&l->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void seq_write_end(seqlock_t * l) {
+    atomic_fetch_add_explicit(&l->seq, 1, memory_order_release);
+}
+
+static inline unsigned seq_read_begin(seqlock_t * l) {
+    unsigned s;
+    while ((s = atomic_load_explicit(&l->seq, memory_order_acquire)) & 1) { }
+    return s;
+}
+
+static inline bool seq_read_retry(seqlock_t * l, unsigned s) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&l->seq, memory_order_relaxed) != s;
+}
+
+// What the UI needs each frame, published by the radio core
+typedef struct {
+    bool linked;
+    bool searching;        // No sender within the link timeout
+    uint32_t frames;       // Frames from the sender so far, wakes the display
+    uint8_t state;         // posture_state_t
+    uint8_t battery_pct;
+    float pitch;
+    float roll;
+} ui_snapshot_t;
+
+static ui_snapshot_t snapshot;
+static seqlock_t snapshot_lock;
+
+// Stats chart: STRIP_COLS columns of |pitch| ending at the current minute,
+// each covering STRIP_ZOOM_MIN[zoom] minutes. The UI picks the zoom, the
+// radio core aggregates history into columns.
+#define STRIP_COLS   240
+#define STRIP_NONE   0xFF
+typedef struct {
+    uint8_t lo, hi;        // Range of |pitch| over the column, whole degrees
+    uint8_t mean;          // STRIP_NONE if the column has no data
+} strip_col_t;
+
+static const uint8_t STRIP_ZOOM_MIN[] = { 1, 3, 6 };       // 4 h, 12 h, 24 h
+static strip_col_t chart_cols[STRIP_COLS];
+static int32_t chart_end;              // Column number (minute / zoom minutes) of the last column
+static uint8_t chart_zoom;             // Zoom the export was made at
+static atomic_uint chart_zoom_req;     // Set by the UI
+static seqlock_t chart_lock;
+
+static void snapshot_read(ui_snapshot_t * out) {
+    unsigned s;
+    do {
+        s = seq_read_begin(&snapshot_lock);
+        *out = snapshot;
+    } while (seq_read_retry(&snapshot_lock, s));
+}
+
+// ======================= HISTORY (radio core) =======================
+// One bucket per minute of receiver uptime. Live data and synced backlog
+// both land here by timestamp, so late records merge into the right minute.
+#define HISTORY_MINUTES 1440
+
+typedef struct {
+    uint32_t minute;       // Receiver minute this bucket currently holds
+    uint16_t seconds;      // Seconds of data seen in this minute
+    uint8_t pitch_lo;      // Range of |pitch|, whole degrees
+    uint8_t pitch_hi;
+    float slouch_s;        // Of which spent slouching
+    float pitch_abs_sum;   // Sum of |pitch| per second
+} history_bucket_t;
+
+static history_bucket_t history[HISTORY_MINUTES];
+static bool history_dirty = false;
+
+// peak is the highest |pitch| over the period, pitch_abs its mean
+static void history_add(int64_t t_ms, float pitch_abs, float peak, float slouch_share, uint16_t seconds) {
+    if (t_ms < 0) return;                       // Older than our own uptime
+    uint32_t minute = t_ms / 60000;
+    history_bucket_t * b = &history[minute % HISTORY_MINUTES];
+    if (b->minute != minute) {
+        memset(b, 0, sizeof(*b));
+        b->minute = minute;
+    }
+    uint8_t lo = pitch_abs < 254 ? pitch_abs : 254, hi = peak < 254 ? peak : 254;
+    if (!b->seconds || lo < b->pitch_lo) b->pitch_lo = lo;
+    if (!b->seconds || hi > b->pitch_hi) b->pitch_hi = hi;
+    b->seconds += seconds;
+    b->slouch_s += slouch_share * seconds;
+    b->pitch_abs_sum += pitch_abs * seconds;
+    history_dirty = true;
+}
+
+static int32_t chart_last_col(int64_t now_ms, uint8_t zoom) {
+    return now_ms / 60000 / STRIP_ZOOM_MIN[zoom];
+}
+
+// New data, a new column due or a zoom change all need a fresh export
+static bool chart_stale(int64_t now_ms) {
+    return history_dirty || atomic_load(&chart_zoom_req) != chart_zoom
+        || chart_last_col(now_ms, chart_zoom) != chart_end;
+}
+
+// Re-aggregates every column; at most 1440 buckets, so no cheaper than
+// this is needed. The UI works out which columns actually changed.
+static void history_export_chart(int64_t now_ms) {
+    PROF_SCOPE(PROF_HISTORY);
+    uint8_t zoom = atomic_load(&chart_zoom_req) % sizeof(STRIP_ZOOM_MIN);
+    int per = STRIP_ZOOM_MIN[zoom];
+    int32_t end = chart_last_col(now_ms, zoom);
+    seq_write_begin(&chart_lock);
+    for (int i = 0; i < STRIP_COLS; i++) {
+        int32_t col = end - (STRIP_COLS - 1) + i;
+        strip_col_t c = { STRIP_NONE, 0, STRIP_NONE };
+        float sum = 0;
+        uint32_t seconds = 0;
+        for (int m = 0; col >= 0 && m < per; m++) {
+            uint32_t minute = col * per + m;
+            history_bucket_t * b = &history[minute % HISTORY_MINUTES];
+            if (b->minute != minute || b->seconds == 0) continue;
+            if (b->pitch_lo < c.lo) c.lo = b->pitch_lo;
+            if (b->pitch_hi > c.hi) c.hi = b->pitch_hi;
+            sum += b->pitch_abs_sum;
+            seconds += b->seconds;
+        }
+        if (seconds) c.mean = (uint8_t)fminf(sum / seconds, 254);
+        else c.lo = c.hi = STRIP_NONE;
+        chart_cols[i] = c;
+    }
+    chart_end = end;
+    chart_zoom = zoom;
+    seq_write_end(&chart_lock);
+}
+
+// ======================= ANALYTICS (radio core) =======================
+// Running posture metrics, each updated in O(1) per sample with fixed
+// memory. A sample credits the time since the previous one to the state
+// that held over it; gaps longer than the link timeout stay untracked.
+// Hours and days count from boot, as there is no wall clock.
+#define ANALYTICS_HOURS  24
+#define ANALYTICS_DAYS   7
+#define HOUR_MS          3600000
+#define DAY_MS           86400000
+
+typedef struct {
+    uint32_t key;              // Hour or day index held
+    uint32_t tracked_ms;       // Time with data
+    uint32_t slouch_ms;
+    uint16_t episodes;         // Slouch episodes started
+    uint32_t episode_max_ms;   // Longest slouch episode
+    uint32_t streak_max_ms;    // Longest good streak
+    float roll_s;              // Roll x seconds; / tracked time = mean side lean
+} rollup_t;
+
+static rollup_t an_session, an_hours[ANALYTICS_HOURS], an_days[ANALYTICS_DAYS];
+
+// The run of one posture state the latest sample belongs to
+static struct {
+    int64_t last_ms;           // Previous sample, -1 after a gap
+    int64_t run_start_ms;
+    uint8_t state;
+    float roll;
+    int64_t gap_from_ms, gap_to_ms;    // Latest stretch with no live samples
+} an = { .last_ms = -1, .gap_from_ms = INT64_MIN / 2, .gap_to_ms = INT64_MAX / 2 };
+
+// What the stats tab shows, refreshed once a second
+typedef struct {
+    rollup_t session, hour, day;
+    uint8_t run_state;
+    uint32_t run_ms;
+} analytics_view_t;
+
+static analytics_view_t analytics_view;
+static seqlock_t analytics_lock;
+
+static rollup_t * rollup_at(rollup_t * ring, int n, uint32_t key) {
+    rollup_t * r = &ring[key % n];
+    if (r->key != key) {
+        memset(r, 0, sizeof(*r));
+        r->key = key;
+    }
+    return r;
+}
+
+static void rollup_credit(rollup_t * r, uint32_t dt_ms, uint32_t slouch_ms, float roll,
+                          uint32_t run_ms, bool slouching) {
+    r->tracked_ms += dt_ms;
+    r->slouch_ms += slouch_ms;
+    r->roll_s += roll * dt_ms / 1000.0f;
+    if (slouching && run_ms > r->episode_max_ms) r->episode_max_ms = run_ms;
+    if (!slouching && run_ms > r->streak_max_ms) r->streak_max_ms = run_ms;
+}
+
+// Every sample, heartbeat and event from a linked sender. gap_ms is the
+// longest silence that still counts as continuous data. Stamps can arrive
+// out of order (a heartbeat overtaking a batch); time up to last_ms is
+// already credited, so an older one is dropped.
+static void analytics_sample(int64_t now_ms, uint8_t state, float roll, uint32_t gap_ms) {
+    PROF_SCOPE(PROF_ANALYTICS);
+    if (an.last_ms >= 0 && now_ms < an.last_ms) return;
+    rollup_t * rs[3] = { &an_session, rollup_at(an_hours, ANALYTICS_HOURS, now_ms / HOUR_MS),
+                         rollup_at(an_days, ANALYTICS_DAYS, now_ms / DAY_MS) };
+    bool gap = an.last_ms < 0 || now_ms - an.last_ms > gap_ms;
+    if (gap) {
+        an.gap_from_ms = an.last_ms < 0 ? INT64_MIN / 2 : an.last_ms;
+        an.gap_to_ms = now_ms;
+    }
+    if (!gap && now_ms > an.last_ms) {
+        bool slouching = an.state == POSTURE_SLOUCH;
+        uint32_t dt = now_ms - an.last_ms;
+        uint32_t run_ms = now_ms - an.run_start_ms;
+        for (int i = 0; i < 3; i++) rollup_credit(rs[i], dt, slouching ? dt : 0, an.roll, run_ms, slouching);
+    }
+    if (gap || state != an.state) {
+        an.run_start_ms = now_ms;
+        if (state == POSTURE_SLOUCH) {
+            for (int i = 0; i < 3; i++) rs[i]->episodes++;
+        }
+    }
+    an.last_ms = now_ms;
+    an.state = state;
+    an.roll = roll;
+}
+
+// A 5 s aggregate synced from the sender's backlog; no runs to follow.
+// The sender owes everything since its last ack, which overlaps the last
+// live samples; only the part inside the latest gap is counted.
+static void analytics_backlog(int64_t t_ms, float slouch_share, float roll) {
+    int64_t from = t_ms - BACKLOG_PERIOD_S * 1000, to = t_ms;
+    if (from < an.gap_from_ms) from = an.gap_from_ms;
+    if (to > an.gap_to_ms) to = an.gap_to_ms;
+    if (t_ms < 0 || to <= from) return;
+    uint32_t dt = to - from;
+    uint32_t slouch_ms = slouch_share * dt;
+    rollup_credit(&an_session, dt, slouch_ms, roll, 0, false);
+    rollup_credit(rollup_at(an_hours, ANALYTICS_HOURS, t_ms / HOUR_MS), dt, slouch_ms, roll, 0, false);
+    rollup_credit(rollup_at(an_days, ANALYTICS_DAYS, t_ms / DAY_MS), dt, slouch_ms, roll, 0, false);
+}
+
+static void rollup_log(const char * what, const rollup_t * r) {
+    if (!r->tracked_ms) return;
+    ESP_LOGI("STATS", "%s %lu: %lu%% good over %lu min, %u episodes (longest %lu s), best streak %lu min, roll %+.1f",
+             what, (unsigned long)r->key,
+             (unsigned long)(100ULL * (r->tracked_ms - r->slouch_ms) / r->tracked_ms),
+             (unsigned long)(r->tracked_ms / 60000), r->episodes,
+             (unsigned long)(r->episode_max_ms / 1000), (unsigned long)(r->streak_max_ms / 60000),
+             r->roll_s * 1000.0f / r->tracked_ms);
+}
+
+// Once a second from ingest_tick: publish the current rollups and log the
+// hour that just ended
+static void analytics_publish(int64_t now_ms) {
+    static uint32_t last_hour;
+    uint32_t hour = now_ms / HOUR_MS;
+    if (hour != last_hour) {
+        const rollup_t * done = &an_hours[last_hour % ANALYTICS_HOURS];
+        if (done->key == last_hour) rollup_log("hour", done);
+        last_hour = hour;
+    }
+    seq_write_begin(&analytics_lock);
+    analytics_view.session = an_session;
+    analytics_view.hour = *rollup_at(an_hours, ANALYTICS_HOURS, hour);
+    analytics_view.day = *rollup_at(an_days, ANALYTICS_DAYS, now_ms / DAY_MS);
+    analytics_view.run_state = an.state;
+    analytics_view.run_ms = an.last_ms < 0 ? 0 : an.last_ms - an.run_start_ms;
+    seq_write_end(&analytics_lock);
+}
 
-// ======================= ESP-NOW LOGIC =======================
+// ======================= SENDER OTA (radio core) =======================
+// Pipelined transfer: up to OTA_WINDOW chunks ahead of the sender's base are
+// in flight. The sender acks with its base and a bitmap of the chunks after
+// it; a gap below the highest acked chunk was lost and is resent at once,
+// anything else unacked after OTA_RTO_MS is resent too. Everything goes
+// unicast to the paired wearable, so every frame gets link-layer retries.
 
+typedef enum { OTA_UI_IDLE, OTA_UI_RUNNING, OTA_UI_DONE, OTA_UI_FAILED } ota_ui_t;
+
+typedef struct {
+    ota_status_t st;
+    uint8_t src[6];
+} ota_reply_t;
+
+static QueueHandle_t ota_reply_q;          // Length 1, the newest status wins
+static atomic_bool ota_running;
+static uint8_t ota_target[6];              // Set before ota_task starts
+static atomic_int ota_ui_state, ota_ui_pct, ota_ui_kbps;
+
+// Length of an ESP app image: header, segments, checksum byte padded to 16,
+// then the SHA-256 the build appends. 0 if it is not a sender image.
+static uint32_t sender_image_len(const uint8_t * img, uint32_t max) {
+    if (max < 24 || img[0] != 0xE9 || (img[12] | img[13] << 8) != OTA_IMAGE_CHIP_ID) return 0;
+    uint32_t pos = 24;
+    for (int i = 0; i < img[1]; i++) {
+        uint32_t seg_len;
+        if (pos + 8 > max) return 0;
+        memcpy(&seg_len, img + pos + 4, 4);
+        pos += 8 + seg_len;
+    }
+    pos = (pos + 16) & ~15u;
+    if (img[23]) pos += 32;
+    return pos <= max ? pos : 0;
+}
+
+// false if the frame can't be queued at all (peer gone, Wi-Fi stopped):
+// the transfer can't make progress, so the caller gives up
+static bool ota_send(const uint8_t * mac, const void * frame, int len) {
+    esp_err_t err;
+    // TX queue full: wait for the driver rather than drop the frame
+    while ((err = esp_now_send(mac, (const uint8_t *)frame, len)) == ESP_ERR_ESPNOW_NO_MEM) vTaskDelay(1);
+    if (err != ESP_OK) ESP_LOGE("OTA", "Send failed: %s", esp_err_to_name(err));
+    return err == ESP_OK;
+}
+
+static void ota_task(void * arg) {
+    static int64_t sent_ms[OTA_WINDOW + 1];    // Last send per chunk in the window
+    const esp_partition_t * part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, OTA_PARTITION_LABEL);
+    const uint8_t * img = NULL;
+    esp_partition_mmap_handle_t map;
+    bool mapped = false, peer_added = false, ok = false;
+    uint8_t peer[6];
+    ota_reply_t r;
+
+    if (!part || esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, (const void **)&img, &map) != ESP_OK) {
+        ESP_LOGE("OTA", "No '%s' partition", OTA_PARTITION_LABEL);
+        goto done;
+    }
+    mapped = true;
+    ota_begin_t b = { .command_id = CMD_OTA_BEGIN, .size = sender_image_len(img, part->size) };
+    if (!b.size) {
+        ESP_LOGE("OTA", "No sender image in '%s'", OTA_PARTITION_LABEL);
+        goto done;
+    }
+    mbedtls_sha256(img, b.size, b.sha256, 0);
+    uint16_t chunks = (b.size + OTA_CHUNK - 1) / OTA_CHUNK;
+
+    // Handshake with the paired wearable; it answers with where to start
+    xQueueReset(ota_reply_q);
+    int64_t deadline = esp_timer_get_time() / 1000 + OTA_BEGIN_MS;
+    bool answered = false;
+    while (!answered && esp_timer_get_time() / 1000 < deadline) {
+        if (!ota_send(ota_target, &b, sizeof(b))) goto done;
+        answered = xQueueReceive(ota_reply_q, &r, pdMS_TO_TICKS(300)) == pdTRUE;
+    }
+    if (!answered || r.st.status != OTA_ST_RECEIVING) {
+        ESP_LOGE("OTA", answered ? "Sender refused the image" : "Sender did not answer");
+        goto done;
+    }
+
+    memcpy(peer, r.src, 6);
+    if (!esp_now_is_peer_exist(peer)) {
+        esp_now_peer_info_t info = { .channel = 1, .encrypt = false };
+        memcpy(info.peer_addr, peer, 6);
+        peer_added = esp_now_add_peer(&info) == ESP_OK;
+    }
+    esp_wifi_config_espnow_rate(WIFI_IF_STA, OTA_PHY_RATE);
+
+    uint16_t base = r.st.base, next = base, first = base;
+    uint32_t sack = r.st.sack, resent = 0;
+    int64_t start_ms = esp_timer_get_time() / 1000, progress_ms = start_ms;
+    ESP_LOGI("OTA", "%lu bytes, %u chunks, starting at %u", (unsigned long)b.size, chunks, base);
+
+    while (base < chunks) {
+        ota_chunk_t c = { .command_id = CMD_OTA_DATA };
+        int64_t now_ms = esp_timer_get_time() / 1000;
+
+        // Checked every pass: a stream of stale replies must not hold off
+        // the timeout any more than silence does
+        if (now_ms - progress_ms > OTA_STALL_MS) {
+            ESP_LOGE("OTA", "Stalled at chunk %u", base);
+            goto done;
+        }
+
+        // Keep the window full
+        while (next < chunks && next <= base + OTA_WINDOW) {
+            c.index = next++;
+            c.len = b.size - c.index * OTA_CHUNK < OTA_CHUNK ? b.size - c.index * OTA_CHUNK : OTA_CHUNK;
+            memcpy(c.data, img + c.index * OTA_CHUNK, c.len);
+            c.crc = esp_crc32_le(0, c.data, c.len);
+            if (!ota_send(peer, &c, offsetof(ota_chunk_t, data) + c.len)) goto done;
+            sent_ms[c.index % (OTA_WINDOW + 1)] = now_ms;
+        }
+
+        bool got = xQueueReceive(ota_reply_q, &r, pdMS_TO_TICKS(OTA_RTO_MS)) == pdTRUE;
+        now_ms = esp_timer_get_time() / 1000;
+        if (got) {
+            if (r.st.status != OTA_ST_RECEIVING) {
+                ESP_LOGE("OTA", "Sender stopped the transfer (%d)", r.st.status);
+                goto done;
+            }
+            if (r.st.base < base) continue;         // Stale
+            if (r.st.base > base) progress_ms = now_ms;
+            base = r.st.base;
+            sack = r.st.sack;
+            if (next < base) next = base;
+        }
+
+        // After a status only chunks below the highest acked one can be
+        // known lost; after a timeout anything unacked is suspect
+        uint16_t upto = next;
+        if (got) upto = sack ? base + 1 + (31 - __builtin_clz(sack)) : base + 1;
+        for (uint16_t i = base; i < upto && i < next; i++) {
+            if (i > base && (sack & (1u << (i - base - 1)))) continue;
+            int64_t * t = &sent_ms[i % (OTA_WINDOW + 1)];
+            if (now_ms - *t < OTA_RTO_MS) continue;
+            c.index = i;
+            c.len = b.size - i * OTA_CHUNK < OTA_CHUNK ? b.size - i * OTA_CHUNK : OTA_CHUNK;
+            memcpy(c.data, img + i * OTA_CHUNK, c.len);
+            c.crc = esp_crc32_le(0, c.data, c.len);
+            if (!ota_send(peer, &c, offsetof(ota_chunk_t, data) + c.len)) goto done;
+            *t = now_ms;
+            resent++;
+        }
+
+        int64_t elapsed = now_ms - start_ms;
+        atomic_store(&ota_ui_pct, base * 100 / chunks);
+        if (elapsed > 0) atomic_store(&ota_ui_kbps, (int)((int64_t)(base - first) * OTA_CHUNK / elapsed));
+    }
+
+    float secs = (esp_timer_get_time() / 1000 - start_ms) / 1000.0f;
+    ESP_LOGI("OTA", "%lu bytes in %.1f s, %.1f kB/s, %lu chunks resent",
+             (unsigned long)((uint32_t)(chunks - first) * OTA_CHUNK), secs,
+             secs > 0 ? (chunks - first) * OTA_CHUNK / secs / 1000 : 0, (unsigned long)resent);
+
+    // The sender hashes the whole image before it answers
+    command_packet_t end = { .command_id = CMD_OTA_END, .value = 0 };
+    deadline = esp_timer_get_time() / 1000 + OTA_DONE_MS;
+    while (!ok && esp_timer_get_time() / 1000 < deadline) {
+        if (!ota_send(peer, &end, sizeof(end))) break;
+        if (xQueueReceive(ota_reply_q, &r, pdMS_TO_TICKS(1000)) != pdTRUE) continue;
+        if (r.st.status == OTA_ST_DONE) ok = true;
+        else if (r.st.status == OTA_ST_ERROR) break;
+    }
+    ESP_LOGI("OTA", ok ? "Sender verified the image and is rebooting" : "Sender did not confirm the image");
+
+done:
+    esp_wifi_config_espnow_rate(WIFI_IF_STA, WIFI_PHY_RATE_1M_L);
+    if (peer_added) esp_now_del_peer(peer);
+    if (mapped) esp_partition_munmap(map);
+    atomic_store(&ota_ui_state, ok ? OTA_UI_DONE : OTA_UI_FAILED);
+    atomic_store(&ota_running, false);
+    vTaskDelete(NULL);
+}
+
+// mac: the paired wearable, NULL if there is none
+static void ota_start(const uint8_t * mac) {
+    if (!mac || RELAY_ENABLED) {
+        ESP_LOGE("OTA", RELAY_ENABLED ? "Update the wearable from its home box" : "No wearable paired");
+        return;
+    }
+    if (atomic_exchange(&ota_running, true)) return;
+    memcpy(ota_target, mac, 6);
+    atomic_store(&ota_ui_pct, 0);
+    atomic_store(&ota_ui_kbps, 0);
+    atomic_store(&ota_ui_state, OTA_UI_RUNNING);
+    xTaskCreatePinnedToCore(ota_task, "ota", 4096, NULL, 4, NULL, RADIO_CORE);
+}
+
+// ======================= USB STREAM (radio core) =======================
+// Each record is a fixed header, the payload bytes as they sit in the rx
+// ring and a CRC32 (zlib-compatible) over header and payload. Nothing is
+// formatted here; the host tool does all decoding. Log text may share the
+// port, so the host resyncs on the sync bytes and drops records whose CRC
+// fails.
+
+#define STREAM_SYNC0       0xA5
+#define STREAM_SYNC1       0x5A
+#define STREAM_RX          0x01    // payload: ESP-NOW frame as received, less its sequence number
+#define STREAM_LINK        0x02    // payload: stream_link_t
+#define STREAM_STATS       0x03    // payload: stream_stats_t
+#define STREAM_INJECT      0x10    // host -> us: frame to replay, t_ms = recorded arrival
+#define STREAM_CMD_START   'S'
+#define STREAM_CMD_STOP    'X'
+#define STREAM_CMD_LIVE    'L'     // End a replay
+
+typedef struct __attribute__((packed)) {
+    uint8_t sync[2];
+    uint8_t type;
+    uint8_t len;        // Payload bytes
+    uint16_t seq;       // Per record, so the host can count gaps
+    uint32_t t_ms;      // Receiver uptime
+} stream_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t up;
+    uint8_t state;
+    uint8_t battery_pct;
+} stream_link_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t rx_dropped;        // Radio frames lost before ingest
+    uint32_t stream_dropped;    // Records that did not fit the USB ring
+    uint32_t stream_sent;
+} stream_stats_t;
+
+#define STREAM_REC_MAX     (sizeof(stream_hdr_t) + 255 + sizeof(uint32_t))
+
+static void replay_frame(const uint8_t * data, int len, uint32_t rec_ms);
+
+#if USB_STREAM_ENABLED
+static bool stream_ready, stream_on;
+static uint16_t stream_seq;
+static uint32_t stream_dropped, stream_sent;
+static uint8_t stream_in[2 * STREAM_REC_MAX];
+static int stream_in_len;
+
+static void stream_init(void) {
+    usb_serial_jtag_driver_config_t cfg = {
+        .tx_buffer_size = USB_STREAM_TX_BUF,
+        .rx_buffer_size = USB_STREAM_RX_BUF,
+    };
+    stream_ready = usb_serial_jtag_driver_install(&cfg) == ESP_OK;
+    if (!stream_ready) {
+        ESP_LOGW("STREAM", "USB driver unavailable, streaming off");
+        return;
+    }
+    // Console output through the same ring, so a log line can never land
+    // in the middle of a record
+    esp_vfs_usb_serial_jtag_use_driver();
+}
+
+// The driver's byte ring takes a whole write or none of it, so a slow or
+// absent host costs dropped records, never a stalled radio core.
+static void stream_emit(uint8_t type, const void * payload, uint8_t len, int64_t now_ms) {
+    if (!stream_on) return;
+    uint8_t buf[sizeof(stream_hdr_t) + 255 + sizeof(uint32_t)];
+    stream_hdr_t * h = (stream_hdr_t *)buf;
+    h->sync[0] = STREAM_SYNC0;
+    h->sync[1] = STREAM_SYNC1;
+    h->type = type;
+    h->len = len;
+    h->seq = stream_seq++;
+    h->t_ms = (uint32_t)now_ms;
+    memcpy(buf + sizeof(*h), payload, len);
+    int n = sizeof(*h) + len;
+    uint32_t crc = esp_crc32_le(0, buf, n);
+    memcpy(buf + n, &crc, sizeof(crc));
+    n += sizeof(crc);
+    if (usb_serial_jtag_write_bytes(buf, n, 0) == n) stream_sent++;
+    else stream_dropped++;
+}
+
+static void stream_emit_link(bool up, uint8_t state, uint8_t battery_pct, int64_t now_ms) {
+    stream_link_t l = { .up = up, .state = state, .battery_pct = battery_pct };
+    stream_emit(STREAM_LINK, &l, sizeof(l), now_ms);
+}
+
+// Consume what the host sent: single-byte commands and framed records,
+// with anything else skipped. Returns true when the host just started a
+// stream.
+static bool stream_parse(void) {
+    bool started = false;
+    int i = 0;
+    while (i < stream_in_len) {
+        uint8_t * p = stream_in + i;
+        int avail = stream_in_len - i;
+        if (p[0] == STREAM_SYNC0) {
+            if (avail < (int)sizeof(stream_hdr_t)) break;
+            stream_hdr_t h;
+            memcpy(&h, p, sizeof(h));
+            if (h.sync[1] == STREAM_SYNC1) {
+                int n = sizeof(h) + h.len;
+                if (avail < n + (int)sizeof(uint32_t)) break;
+                uint32_t crc;
+                memcpy(&crc, p + n, sizeof(crc));
+                if (crc == esp_crc32_le(0, p, n)) {
+                    if (h.type == STREAM_INJECT) replay_frame(p + sizeof(h), h.len, h.t_ms);
+                    i += n + sizeof(crc);
+                    continue;
+                }
+            }
+        }
+        else if (p[0] == STREAM_CMD_START && !stream_on) {
+            stream_on = started = true;
+            stream_seq = 0;
+            stream_dropped = stream_sent = 0;
+        }
+        else if (p[0] == STREAM_CMD_STOP) stream_on = false;
+        else if (p[0] == STREAM_CMD_LIVE) replay_frame(NULL, 0, 0);
+        i++;
+    }
+    stream_in_len -= i;
+    memmove(stream_in, stream_in + i, stream_in_len);
+    return started;
+}
+
+// Host input, one read per ingest pass so a fast replay cannot starve the
+// rest of the loop. While replaying, waits up to wait_ms for input instead
+// of the radio. Returns true when the host just started a stream.
+static bool stream_poll(uint32_t wait_ms) {
+    if (!stream_ready) return false;
+    int n = usb_serial_jtag_read_bytes(stream_in + stream_in_len, sizeof(stream_in) - stream_in_len,
+                                       pdMS_TO_TICKS(wait_ms));
+    if (n <= 0) return false;
+    stream_in_len += n;
+    return stream_parse();
+}
+
+static void stream_stats(uint32_t rx_dropped, int64_t now_ms) {
+    static int64_t last_stats_ms;
+    if (!stream_on || now_ms - last_stats_ms < USB_STREAM_STATS_MS) return;
+    last_stats_ms = now_ms;
+    stream_stats_t st = { .rx_dropped = rx_dropped, .stream_dropped = stream_dropped, .stream_sent = stream_sent };
+    stream_emit(STREAM_STATS, &st, sizeof(st), now_ms);
+}
+#else
+#define stream_init()                               ((void)0)
+#define stream_emit(type, payload, len, now_ms)     ((void)0)
+#define stream_emit_link(up, state, bat, now_ms)    ((void)0)
+#define stream_poll(wait_ms)                        false
+#define stream_stats(rx_dropped, now_ms)            ((void)0)
+#endif
+
+// ======================= ESP-NOW LOGIC (radio core) =======================
+
+typedef struct {
+    int64_t t_us;           // Arrival, uptime
+    uint8_t len;            // Without a wearable frame's sequence number
+    uint16_t seq;
+    uint8_t src[6];
+    uint8_t data[ESP_NOW_MAX_DATA_LEN];
+} rx_frame_t;
+
+static rx_frame_t rx_ring[RX_RING_SLOTS];
+static spsc_t rx_q;
+static atomic_uint rx_dropped;
+static TaskHandle_t ingest_task_handle;
+static const uint8_t REPLAY_SRC[6] = {0};
+
+// Ingest time. Normally uptime, but a replay runs on the recording's own
+// clock, which can race far ahead of real time; the offset keeps ingest
+// time moving forward once live frames take over again.
+static int64_t clock_offset_ms;
+static atomic_bool replay_active;          // Live frames are ignored while set
+static bool relay_delivering;              // handle_frame is seeing a relayed frame
+static struct {
+    int64_t origin_ms;      // Ingest time the first replayed frame maps to
+    uint32_t first_rec_ms;  // Its recorded arrival time
+    int64_t now_ms;         // Ingest time of the latest replayed frame
+    int64_t last_input_ms;  // Uptime of the latest host input, for REPLAY_IDLE_MS
+} replay;
+
+// Link state, owned by ingest_task
+static struct {
+    bool up;
+    bool paired;
+    uint8_t mac[6];         // Paired wearable
+    int64_t heard_ms;       // Its latest frame of any kind
+    int64_t last_rx_ms;
+    uint32_t timeout_ms;
+    uint8_t state;
+    uint8_t battery_pct;
+    float pitch;
+    float roll;
+    int last_event_seq;
+    uint16_t last_backlog_seq;
+    uint8_t activity;
+    uint32_t frames;
+} link = { .timeout_ms = CONNECTION_TIMEOUT_MS, .battery_pct = BATTERY_UNKNOWN, .last_event_seq = -1 };
+
+// Runs in the Wi-Fi task: copy out and wake the ingest task, nothing else.
 static void on_data_recv(const esp_now_recv_info_t * info, const uint8_t * incomingData, int len) {
-    if (len == sizeof(posture_packet_t)) {
-        posture_packet_t packet;
-        memcpy(&packet, incomingData, sizeof(packet));
-        xQueueOverwrite(posture_queue, &packet);
+    if (len <= 0 || len > ESP_NOW_MAX_DATA_LEN) return;
+    if (atomic_load_explicit(&replay_active, memory_order_relaxed)) return;
+    // Addressed to us alone: only a wearable's OTA status comes that way
+    if (memcmp(info->des_addr, BROADCAST_MAC, 6) && incomingData[0] != PKT_OTA_STATUS) return;
+    uint16_t seq = 0;
+    if (incomingData[0] != PKT_RELAY) {
+        if (len <= (int)sizeof(seq)) return;
+        len -= sizeof(seq);
+        memcpy(&seq, incomingData + len, sizeof(seq));
     }
+    int slot = spsc_reserve(&rx_q, RX_RING_SLOTS);
+    if (slot < 0) {
+        atomic_fetch_add_explicit(&rx_dropped, 1, memory_order_relaxed);
+        return;
+    }
+    rx_ring[slot].t_us = esp_timer_get_time();
+    rx_ring[slot].len = len;
+    rx_ring[slot].seq = seq;
+    memcpy(rx_ring[slot].src, info->src_addr, 6);
+    memcpy(rx_ring[slot].data, incomingData, len);
+    spsc_publish(&rx_q);
+    xTaskNotifyGive(ingest_task_handle);
 }
 
-void send_calibration_command() {
+static void sender_peer(const uint8_t * mac) {
+    if (esp_now_is_peer_exist(mac)) return;
+    esp_now_peer_info_t info = { .channel = 1, .encrypt = false };
+    memcpy(info.peer_addr, mac, 6);
+    esp_now_add_peer(&info);
+}
+
+// Unicast, so other wearables in range never take this box's commands
+// as their own
+static void send_to(const uint8_t * mac, const void * frame, int len) {
+    if (atomic_load(&replay_active)) return;    // Replayed frames get no acks; keep the real sender out of it
+    // A relay only passes the wearable on. Acks and settings come from its
+    // home box, so it keeps its backlog until home really has it.
+    if (RELAY_ENABLED) return;
+    sender_peer(mac);
+    esp_now_send(mac, (const uint8_t *)frame, len);
+}
+
+static void send_to_sender(const void * frame, int len) {
+    if (link.paired) send_to(link.mac, frame, len);
+}
+
+static void send_command(uint8_t id, uint8_t value) {
     command_packet_t cmd;
-    cmd.command_id = 1; 
-    cmd.value = 0;
-    esp_now_send(BROADCAST_MAC, (uint8_t *)&cmd, sizeof(cmd));
+    cmd.command_id = id; 
+    cmd.value = value;
+    send_to_sender(&cmd, sizeof(cmd));
+}
+
+// From the UI core: hand the command to the radio core instead of sending
+static void post_command(uint8_t id, uint8_t value) {
+    command_packet_t cmd = { .command_id = id, .value = value };
+    xQueueSend(cmd_queue, &cmd, 0);
+}
+
+void send_calibration_command() {
+    post_command(CMD_CALIBRATE, 0);
 }
 
 void send_vibration_setting(bool enabled) {
-    command_packet_t cmd;
-    cmd.command_id = 2; 
-    cmd.value = enabled ? 1 : 0; 
-    esp_now_send(BROADCAST_MAC, (uint8_t *)&cmd, sizeof(cmd));
+    post_command(CMD_VIBRATION, enabled ? 1 : 0);
+}
+
+static void send_sender_settings(void) {
+    send_command(CMD_SET_ENTER_DEG, sender_cfg.enter_deg);
+    send_command(CMD_SET_EXIT_DEG, sender_cfg.exit_deg);
+    send_command(CMD_SET_DWELL, sender_cfg.dwell_ds);
+    send_command(CMD_SET_COOLDOWN, sender_cfg.cooldown_s);
+    send_command(CMD_SET_TX_POLICY, sender_cfg.tx_policy);
+    send_command(CMD_SET_TX_DELTA, sender_cfg.tx_delta_dd);
+}
+
+static void load_sender_settings(void) {
+    nvs_handle_t h;
+    if (nvs_open("sender", NVS_READONLY, &h) != ESP_OK) return;
+    size_t len = sizeof(sender_cfg);
+    nvs_get_blob(h, "cfg", &sender_cfg, &len);
+    nvs_close(h);
+}
+
+static void save_sender_settings(void) {
+    nvs_handle_t h;
+    if (nvs_open("sender", NVS_READWRITE, &h) != ESP_OK) return;
+    nvs_set_blob(h, "cfg", &sender_cfg, sizeof(sender_cfg));
+    nvs_commit(h);
+    nvs_close(h);
+}
+
+static void load_display_settings(void) {
+    nvs_handle_t h;
+    if (nvs_open("display", NVS_READONLY, &h) != ESP_OK) return;
+    nvs_get_u8(h, "off_min", &screen_off_min);
+    nvs_close(h);
+}
+
+static void save_display_settings(void) {
+    nvs_handle_t h;
+    if (nvs_open("display", NVS_READWRITE, &h) != ESP_OK) return;
+    nvs_set_u8(h, "off_min", screen_off_min);
+    nvs_commit(h);
+    nvs_close(h);
+}
+
+static void link_seen(int64_t now_ms) {
+    static bool first = true;
+    if (first) {
+        first = false;
+        boot_phase("first packet", 0);
+    }
+    if (!link.up) {
+        link.up = true;
+        send_sender_settings();   // Make sure the sender runs this user's thresholds
+        stream_emit_link(true, link.state, link.battery_pct, now_ms);
+    }
+    link.last_rx_ms = now_ms;
+    link.frames++;
+}
+
+// False for frames from any wearable but the paired one; pairs if none is
+static bool pair_accept(const uint8_t * src, int64_t now_ms) {
+    static const uint8_t wanted[6] = SENDER_MAC;
+    if (!link.paired) {
+        if (memcmp(wanted, BROADCAST_MAC, 6) && memcmp(src, wanted, 6)) return false;
+        memcpy(link.mac, src, 6);
+        link.paired = true;
+        sender_peer(src);
+        ESP_LOGI("LINK", "Paired with %02x:%02x:%02x:%02x:%02x:%02x",
+                 src[0], src[1], src[2], src[3], src[4], src[5]);
+    }
+    else if (memcmp(src, link.mac, 6)) return false;
+    link.heard_ms = now_ms;
+    return true;
+}
+
+// Answer straight from the drain loop: the sender only listens briefly.
+// The time spent queued here is measured and reported, so it costs no accuracy.
+static void time_reply(const rx_frame_t * f) {
+    if (f->len != sizeof(time_req_t)) return;
+    time_sync_t r = { .command_id = CMD_TIME_SYNC, .seq = f->data[1], .rx_us = f->t_us };
+    sender_peer(f->src);
+    r.hold_us = (uint32_t)(esp_timer_get_time() - f->t_us);
+    esp_now_send(f->src, (uint8_t *)&r, sizeof(r));
+}
+
+// Ingest time of a reading stamped by the sender, so analytics count from
+// when the posture was measured rather than when the frame got through.
+// Falls back to arrival for unsynced stamps, replays (recorded stamps are
+// on a past uptime) and relayed frames. Reading-to-arrival latency is logged per minute.
+static int64_t frame_time(uint32_t stamp, int64_t now_ms) {
+    static struct { int32_t min, max; int64_t sum; uint32_t n; int64_t last_log_ms; } lat;
+    if (!stamp || atomic_load(&replay_active) || relay_delivering) return now_ms;     // A relay's clock, not ours
+    int32_t latency = (int32_t)((uint32_t)(now_ms - clock_offset_ms) - stamp);
+    if (latency < -SYNC_MAX_LATENCY_MS || latency > SYNC_MAX_LATENCY_MS) return now_ms;
+    if (!lat.n || latency < lat.min) lat.min = latency;
+    if (!lat.n || latency > lat.max) lat.max = latency;
+    lat.sum += latency;
+    lat.n++;
+    if (now_ms - lat.last_log_ms >= SYNC_LOG_MS) {
+        ESP_LOGI("SYNC", "Reading to arrival: min %ld avg %ld max %ld ms over %lu frames",
+                 (long)lat.min, (long)(lat.sum / lat.n), (long)lat.max, (unsigned long)lat.n);
+        lat.n = 0;
+        lat.sum = 0;
+        lat.last_log_ms = now_ms;
+    }
+    return latency > 0 ? now_ms - latency : now_ms;     // Sync error can put a stamp a ms ahead
+}
+
+static bool batch_varint(const uint8_t * d, int len, int * pos, uint32_t * v) {
+    *v = 0;
+    for (int shift = 0; shift < 32 && *pos < len; shift += 7) {
+        uint8_t b = d[(*pos)++];
+        *v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+// False unless the frame is well formed and used to the last byte
+static bool batch_decode(const uint8_t * d, int len, batch_t * b) {
+    if (len < BATCH_MIN_LEN) return false;
+    b->flags = d[1];
+    b->count = d[2];
+    b->state = d[3];
+    if (!b->count || b->count > BATCH_MAX_SAMPLES) return false;
+    int pos = 4;
+    b->battery_pct = (b->flags & BATCH_HAS_BATTERY) ? d[pos++] : BATTERY_UNKNOWN;
+    b->activity = (b->flags & BATCH_HAS_ACTIVITY) ? d[pos++] : 0;
+    b->t_ms = 0;
+    if (b->flags & BATCH_HAS_TIME) {
+        if (pos + 4 > len) return false;
+        memcpy(&b->t_ms, d + pos, 4);
+        pos += 4;
+    }
+    if (pos + 4 > len) return false;
+    memcpy(&b->pitch_dd[0], d + pos, 2);
+    memcpy(&b->roll_dd[0], d + pos + 2, 2);
+    pos += 4;
+    b->at_ms[0] = 0;
+    for (int i = 1; i < b->count; i++) {
+        uint32_t dt, zp, zr;
+        if (!batch_varint(d, len, &pos, &dt) || !batch_varint(d, len, &pos, &zp)
+            || !batch_varint(d, len, &pos, &zr)) return false;
+        b->at_ms[i] = b->at_ms[i - 1] + dt;
+        b->pitch_dd[i] = b->pitch_dd[i - 1] + (int32_t)((zp >> 1) ^ -(zp & 1));
+        b->roll_dd[i] = b->roll_dd[i - 1] + (int32_t)((zr >> 1) ^ -(zr & 1));
+    }
+    return pos == len;
+}
+
+static void handle_frame(const uint8_t * data, int len, const uint8_t * src, int64_t now_ms) {
+    PROF_SCOPE(PROF_FRAME);
+    if (len == sizeof(posture_packet_t) && data[0] == PKT_SAMPLE) {
+        posture_packet_t packet;
+        memcpy(&packet, data, sizeof(packet));
+        link_seen(now_ms);
+        link.state = packet.state;      // Samples carry the state too, covering lost events
+        link.pitch = packet.pitch;
+        link.roll = packet.roll;
+        analytics_sample(frame_time(packet.t_ms, now_ms), packet.state, packet.roll, link.timeout_ms);
+    }
+    else if (len == sizeof(heartbeat_packet_t) && data[0] == PKT_HEARTBEAT) {
+        heartbeat_packet_t hb;
+        memcpy(&hb, data, sizeof(hb));
+        link_seen(now_ms);
+        link.state = hb.state;
+        link.pitch = hb.pitch;
+        link.roll = hb.roll;
+        if (hb.battery_pct != BATTERY_UNKNOWN) link.battery_pct = hb.battery_pct;
+        if (hb.activity != link.activity) {
+            static const char * names[] = { "sitting", "standing", "moving" };
+            link.activity = hb.activity;
+            ESP_LOGI("LINK", "Sender activity: %s", hb.activity <= ACT_MOVING ? names[hb.activity] : "?");
+        }
+        analytics_sample(frame_time(hb.t_ms, now_ms), hb.state, hb.roll, link.timeout_ms);
+
+        // A heartbeat tells us how long the sender may legitimately stay quiet
+        uint32_t quiet_ms = hb.hb_interval_ds * 100 * HEARTBEAT_MISSES + HEARTBEAT_SLACK_MS;
+        link.timeout_ms = quiet_ms > CONNECTION_TIMEOUT_MS ? quiet_ms : CONNECTION_TIMEOUT_MS;
+
+        command_packet_t ack = { .command_id = CMD_HEARTBEAT_ACK, .value = 0 };
+        send_to(src, &ack, sizeof(ack));
+    }
+    else if (len >= (int)offsetof(backlog_frame_t, rec) && data[0] == PKT_BACKLOG) {
+        backlog_frame_t f;
+        memcpy(&f, data, (size_t)len > sizeof(f) ? sizeof(f) : (size_t)len);
+        if (f.count > BACKLOG_PER_FRAME
+            || (size_t)len != offsetof(backlog_frame_t, rec) + f.count * sizeof(backlog_rec_t)) return;
+
+        // Retransmits of a frame we already merged only need the ack again
+        if (f.seq != link.last_backlog_seq) {
+            link.last_backlog_seq = f.seq;
+            int64_t offset = now_ms - f.now_ms;    // Rebase sender uptime onto ours
+            for (int i = 0; i < f.count; i++) {
+                history_add(f.rec[i].t_ms + offset, abs(f.rec[i].pitch_dd) / 10.0f, f.rec[i].max_pitch,
+                            f.rec[i].slouch_frac / 255.0f, BACKLOG_PERIOD_S);
+                analytics_backlog(f.rec[i].t_ms + offset, f.rec[i].slouch_frac / 255.0f,
+                                  f.rec[i].roll_dd / 10.0f);
+            }
+        }
+        backlog_ack_t ack = { .command_id = CMD_BACKLOG_ACK, .value = 0, .seq = f.seq };
+        send_to(src, &ack, sizeof(ack));
+    }
+    else if (len == sizeof(ota_status_t) && data[0] == PKT_OTA_STATUS) {
+        ota_reply_t r;
+        memcpy(&r.st, data, sizeof(r.st));
+        memcpy(r.src, src, 6);
+        xQueueOverwrite(ota_reply_q, &r);
+    }
+    else if (len >= (int)offsetof(capture_frame_t, data) && data[0] == PKT_CAPTURE) {
+        link_seen(now_ms);      // The frames themselves only go out over USB
+    }
+    else if (len >= BATCH_MIN_LEN && data[0] == PKT_BATCH) {
+        static batch_t b;       // Ingest task only; too big for its stack
+        if (!batch_decode(data, len, &b)) return;
+        link_seen(now_ms);
+        if (b.flags & BATCH_HAS_BATTERY && b.battery_pct != BATTERY_UNKNOWN) link.battery_pct = b.battery_pct;
+        if (b.flags & BATCH_HAS_ACTIVITY) link.activity = b.activity;
+        // The sender flushes right after its newest sample, so that one is
+        // (about) now; the shared clock says exactly when if it was synced
+        int last = b.count - 1;
+        uint32_t span = b.at_ms[last];
+        int64_t last_ms = b.t_ms ? frame_time(b.t_ms + span, now_ms) : now_ms;
+        for (int i = 0; i < b.count; i++) {
+            analytics_sample(last_ms - span + b.at_ms[i], b.state, b.roll_dd[i] / 10.0f, link.timeout_ms);
+        }
+        link.state = b.state;
+        link.pitch = b.pitch_dd[last] / 10.0f;
+        link.roll = b.roll_dd[last] / 10.0f;
+    }
+    else if (len == sizeof(posture_event_t) && data[0] == PKT_EVENT) {
+        posture_event_t ev;
+        memcpy(&ev, data, sizeof(ev));
+        if (ev.seq == link.last_event_seq) return;
+        link.last_event_seq = ev.seq;
+        link.state = ev.state;
+        analytics_sample(frame_time(ev.t_ms, now_ms), ev.state, link.roll, link.timeout_ms);
+    }
+}
+
+static void publish_snapshot(int64_t now_ms) {
+    seq_write_begin(&snapshot_lock);
+    snapshot.linked = link.up;
+    snapshot.searching = (now_ms - link.last_rx_ms) > link.timeout_ms;
+    snapshot.frames = link.frames;
+    snapshot.state = link.state;
+    snapshot.battery_pct = link.battery_pct;
+    snapshot.pitch = link.pitch;
+    snapshot.roll = link.roll;
+    seq_write_end(&snapshot_lock);
+}
+
+// Link timeout and the once-a-second history sample. Steps through every
+// second up to now_ms, so a replay that jumps ahead still sees the link
+// drop and the history fill exactly as they did live.
+static void ingest_tick(int64_t now_ms) {
+    static int64_t last_second_ms;
+    bool stepped = false;
+    while (now_ms - last_second_ms >= 1000) {
+        last_second_ms += 1000;
+        stepped = true;
+        if (link.up && (last_second_ms - link.last_rx_ms) > link.timeout_ms) {
+            link.up = false;
+            stream_emit_link(false, link.state, link.battery_pct, last_second_ms);
+        }
+        // Live data: one history second per second the link is up
+        if (link.up) {
+            history_add(last_second_ms, fabsf(link.pitch), fabsf(link.pitch), link.state == POSTURE_SLOUCH, 1);
+        }
+    }
+    if (link.up && (now_ms - link.last_rx_ms) > link.timeout_ms) {
+        link.up = false;
+        stream_emit_link(false, link.state, link.battery_pct, now_ms);
+    }
+    if (link.paired && !link.up && now_ms - link.heard_ms > link.timeout_ms) {
+        link.paired = false;    // Free for whichever wearable turns up next
+        esp_now_del_peer(link.mac);
+        ESP_LOGI("LINK", "Unpaired");
+    }
+    if (stepped && chart_stale(now_ms)) {
+        history_dirty = false;
+        history_export_chart(now_ms);
+    }
+    if (stepped) analytics_publish(now_ms);
+}
+
+// A recorded frame from the host, handled as if it had just arrived over
+// the air at its recorded time. NULL ends the replay.
+static void replay_frame(const uint8_t * data, int len, uint32_t rec_ms) {
+    int64_t uptime_ms = esp_timer_get_time() / 1000;
+    if (!data) {
+        if (!atomic_load(&replay_active)) return;
+        if (replay.now_ms - uptime_ms > clock_offset_ms) clock_offset_ms = replay.now_ms - uptime_ms;
+        atomic_store(&replay_active, false);
+        ESP_LOGI("REPLAY", "Back to live radio");
+        return;
+    }
+    if (!atomic_load(&replay_active)) {
+        atomic_store(&replay_active, true);
+        replay.origin_ms = uptime_ms + clock_offset_ms;
+        replay.first_rec_ms = rec_ms;
+        replay.now_ms = replay.origin_ms;
+        ESP_LOGI("REPLAY", "Replaying host frames, live radio ignored");
+    }
+    replay.last_input_ms = uptime_ms;
+    int64_t t_ms = replay.origin_ms + (uint32_t)(rec_ms - replay.first_rec_ms);
+    if (t_ms > replay.now_ms) replay.now_ms = t_ms;     // Never let ingest time run backwards
+    ingest_tick(replay.now_ms);
+    stream_emit(STREAM_RX, data, len, replay.now_ms);
+    handle_frame(data, len, REPLAY_SRC, replay.now_ms);
+}
+
+// ======================= RELAY (radio core) =======================
+static const uint8_t RELAY_HOME[6] = RELAY_HOME_MAC;
+static uint8_t own_mac[6];
+
+// Open-addressed hash set of recent frames. Entries older than
+// RELAY_DEDUP_MS count as free, so it never needs clearing.
+static struct {
+    uint8_t mac[6];
+    uint16_t seq;
+    int64_t t_ms;          // 0 = empty
+} dedup[RELAY_DEDUP_SLOTS];
+
+static struct {
+    uint32_t forwarded, delivered, duplicates;
+    int64_t last_log_ms;
+} relay_stats;
+
+// True if this wearable's frame was already seen; records it either way.
+// A wearable's consecutive frames land in consecutive slots.
+static bool dedup_seen(const uint8_t * src, uint16_t seq, int64_t now_ms) {
+    uint32_t home = esp_crc32_le(0, src, 6) + seq;
+    int free_slot = -1;
+    for (int i = 0; i < RELAY_DEDUP_PROBES; i++) {
+        int slot = (home + i) & (RELAY_DEDUP_SLOTS - 1);
+        bool live = dedup[slot].t_ms && now_ms - dedup[slot].t_ms < RELAY_DEDUP_MS;
+        if (live && dedup[slot].seq == seq && !memcmp(dedup[slot].mac, src, 6)) return true;
+        if (!live && free_slot < 0) free_slot = slot;
+    }
+    if (free_slot < 0) free_slot = home & (RELAY_DEDUP_SLOTS - 1);    // All busy: evict
+    memcpy(dedup[free_slot].mac, src, 6);
+    dedup[free_slot].seq = seq;
+    dedup[free_slot].t_ms = now_ms;
+    return false;
+}
+
+static void relay_forward(const uint8_t * data, int len, const uint8_t * src, uint16_t seq, uint8_t hops) {
+    if (!RELAY_ENABLED || hops >= RELAY_MAX_HOPS || len > (int)sizeof(((relay_frame_t *)0)->data)) return;
+    relay_frame_t r = { .type = PKT_RELAY, .hops = hops + 1, .seq = seq };
+    memcpy(r.dest, RELAY_HOME, 6);
+    memcpy(r.src, src, 6);
+    memcpy(r.data, data, len);
+    esp_now_send(BROADCAST_MAC, (uint8_t *)&r, offsetof(relay_frame_t, data) + len);
+    relay_stats.forwarded++;
+}
+
+// The paired wearable's frame, heard straight from the air. False if a
+// relay got its copy here first. Time requests are not passed on, a
+// relayed exchange times nothing.
+static bool relay_direct(const rx_frame_t * f, int64_t now_ms) {
+    if (dedup_seen(f->src, f->seq, now_ms)) return false;
+    if (f->data[0] != PKT_TIME_REQ) relay_forward(f->data, f->len, f->src, f->seq, 0);
+    return true;
+}
+
+// A frame another receiver passed on: show it if it is for us, and pass it
+// further unless we are where it was going
+static void relay_receive(const rx_frame_t * f, int64_t now_ms) {
+    int n = f->len - (int)offsetof(relay_frame_t, data);
+    if (n <= 0) return;
+    relay_frame_t r;
+    memcpy(&r, f->data, f->len);
+    if (dedup_seen(r.src, r.seq, now_ms)) {
+        relay_stats.duplicates++;
+        return;
+    }
+    bool for_us = !memcmp(r.dest, own_mac, 6);
+    if (!for_us) relay_forward(r.data, n, r.src, r.seq, r.hops);
+    if (!for_us && memcmp(r.dest, BROADCAST_MAC, 6)) return;
+    if (!pair_accept(r.src, now_ms)) return;
+    relay_stats.delivered++;
+    stream_emit(STREAM_RX, r.data, n, now_ms);
+    relay_delivering = true;
+    handle_frame(r.data, n, r.src, now_ms);
+    relay_delivering = false;
+}
+
+static void relay_poll(int64_t now_ms) {
+    if (now_ms - relay_stats.last_log_ms < RELAY_LOG_MS) return;
+    relay_stats.last_log_ms = now_ms;
+    if (!relay_stats.forwarded && !relay_stats.delivered && !relay_stats.duplicates) return;
+    ESP_LOGI("RELAY", "Forwarded %lu, delivered %lu, duplicates dropped %lu",
+             (unsigned long)relay_stats.forwarded, (unsigned long)relay_stats.delivered,
+             (unsigned long)relay_stats.duplicates);
+    relay_stats.forwarded = relay_stats.delivered = relay_stats.duplicates = 0;
+}
+
+static void ingest_task(void * arg) {
+    while (1) {
+        bool replaying = atomic_load(&replay_active);
+        ulTaskNotifyTake(pdTRUE, replaying ? 0 : pdMS_TO_TICKS(INGEST_PERIOD_MS));
+
+        int slot;
+        bool heard = false;
+        while ((slot = spsc_peek(&rx_q, RX_RING_SLOTS)) >= 0) {
+            rx_frame_t * f = &rx_ring[slot];
+            int64_t t_ms = f->t_us / 1000 + clock_offset_ms;
+            if (f->data[0] == PKT_RELAY) {
+                relay_receive(f, t_ms);
+            } else if (pair_accept(f->src, t_ms) && relay_direct(f, t_ms)) {
+                // Any box answers its own wearable, relays included; relayed
+                // requests never get here, an exchange over two hops times nothing
+                if (f->data[0] == PKT_TIME_REQ) time_reply(f);
+                stream_emit(STREAM_RX, f->data, f->len, t_ms);
+                handle_frame(f->data, f->len, f->src, t_ms);
+            }
+            spsc_consume(&rx_q);
+            heard = true;
+        }
+        // Host input; during a replay this is where the frames come from
+        bool started = stream_poll(replaying ? INGEST_PERIOD_MS : 0);
+        int64_t uptime_ms = esp_timer_get_time() / 1000;
+        if (atomic_load(&replay_active) && uptime_ms - replay.last_input_ms > REPLAY_IDLE_MS) {
+            replay_frame(NULL, 0, 0);
+        }
+        int64_t now_ms = atomic_load(&replay_active) ? replay.now_ms : uptime_ms + clock_offset_ms;
+        if (started) stream_emit_link(link.up, link.state, link.battery_pct, now_ms);
+        stream_stats(atomic_load(&rx_dropped), now_ms);
+        relay_poll(now_ms);
+
+        // The wearable's radio naps between its own transmissions and only
+        // listens just after one, so commands wait for the next frame from it
+        command_packet_t cmd;
+        while (heard && xQueueReceive(cmd_queue, &cmd, 0) == pdTRUE) {
+            if (cmd.command_id == CMD_OTA_BEGIN) ota_start(link.paired ? link.mac : NULL);
+            else send_command(cmd.command_id, cmd.value);
+        }
+        if (atomic_exchange(&display_cfg_dirty, false)) save_display_settings();
+        if (heard && atomic_exchange(&sender_cfg_dirty, false)) {
+            save_sender_settings();
+            send_sender_settings();
+        }
+
+        ingest_tick(now_ms);
+        publish_snapshot(now_ms);
+    }
 }
 
 static void init_esp_now(void) {
-    posture_queue = xQueueCreate(1, sizeof(posture_packet_t));
+    ota_reply_q = xQueueCreate(1, sizeof(ota_reply_t));
+    stream_init();
+    xTaskCreatePinnedToCore(ingest_task, "ingest", 4096, NULL, 5, &ingest_task_handle, RADIO_CORE);
     ESP_ERROR_CHECK(esp_now_init());
     ESP_ERROR_CHECK(esp_now_register_recv_cb(on_data_recv));
     
@@ -108,6 +1783,7 @@ static void init_esp_now(void) {
     peerInfo.channel = 1;
     peerInfo.encrypt = false;
     esp_now_add_peer(&peerInfo);
+    esp_wifi_get_mac(WIFI_IF_STA, own_mac);
 }
 
 void wifi_init_offline(void) {
@@ -119,6 +1795,122 @@ void wifi_init_offline(void) {
     ESP_ERROR_CHECK(esp_wifi_set_channel(1, WIFI_SECOND_CHAN_NONE));
 }
 
+// ======================= THEME =======================
+// Shared styles, initialised once before the builders run. Widgets only hold
+// a pointer to them instead of a heap-allocated local style list each, and a
+// status colour change is a state flip resolved against the styles already
+// attached.
+#define STATE_ALERT   LV_STATE_USER_1     // Red
+#define STATE_OK      LV_STATE_USER_2     // Green
+#define STATE_WARN    LV_STATE_USER_3     // Orange
+#define STATE_IDLE    LV_STATE_USER_4     // Gray
+#define STATE_STATUS  (STATE_ALERT | STATE_OK | STATE_WARN | STATE_IDLE)
+
+static lv_style_t style_card, style_panel, style_btn_flat;
+static lv_style_t style_label_muted, style_label_accent, style_label_white;
+static lv_style_t style_font_12, style_font_14, style_font_20;
+static lv_style_t style_alert, style_ok, style_warn, style_idle;
+static lv_style_t style_dot_good, style_dot_bad;
+static lv_style_t style_track, style_tick;
+static lv_style_t style_tank, style_tank_fill;
+static lv_style_t style_accent_bg, style_nav_bar;
+
+static void text_style(lv_style_t * s, lv_color_t c) {
+    lv_style_init(s);
+    lv_style_set_text_color(s, c);
+}
+
+static void font_style(lv_style_t * s, const lv_font_t * f) {
+    lv_style_init(s);
+    lv_style_set_text_font(s, f);
+}
+
+static void theme_init(void) {
+    lv_style_init(&style_card);
+    lv_style_set_bg_color(&style_card, COLOR_CARD_TOP);
+    lv_style_set_bg_grad_color(&style_card, COLOR_CARD_BOT);
+    lv_style_set_bg_grad_dir(&style_card, LV_GRAD_DIR_VER);
+    lv_style_set_border_color(&style_card, lv_color_white());
+    lv_style_set_border_opa(&style_card, LV_OPA_20);
+    lv_style_set_border_width(&style_card, 1);
+    lv_style_set_radius(&style_card, 16);
+
+    lv_style_init(&style_panel);
+    lv_style_set_bg_opa(&style_panel, LV_OPA_TRANSP);
+    lv_style_set_border_width(&style_panel, 0);
+
+    lv_style_init(&style_btn_flat);
+    lv_style_set_bg_opa(&style_btn_flat, LV_OPA_TRANSP);
+    lv_style_set_shadow_width(&style_btn_flat, 0);
+    lv_style_set_border_width(&style_btn_flat, 0);
+
+    text_style(&style_label_muted, COLOR_TEXT_GRAY);
+    lv_style_set_text_font(&style_label_muted, &lv_font_montserrat_12);
+    text_style(&style_label_accent, COLOR_CYAN);
+    text_style(&style_label_white, lv_color_white());
+    font_style(&style_font_12, &lv_font_montserrat_12);
+    font_style(&style_font_14, &lv_font_montserrat_14);
+    font_style(&style_font_20, &lv_font_montserrat_20);
+
+    text_style(&style_alert, COLOR_RED);
+    text_style(&style_ok, COLOR_GREEN);
+    text_style(&style_warn, COLOR_ORANGE);
+    text_style(&style_idle, COLOR_TEXT_GRAY);
+
+    lv_style_init(&style_dot_good);
+    lv_style_set_radius(&style_dot_good, LV_RADIUS_CIRCLE);
+    lv_style_set_bg_color(&style_dot_good, COLOR_CYAN);
+    lv_style_set_border_width(&style_dot_good, 2);
+    lv_style_set_border_color(&style_dot_good, lv_color_white());
+    lv_style_set_shadow_width(&style_dot_good, 10);
+    lv_style_set_shadow_color(&style_dot_good, COLOR_CYAN);
+    lv_style_init(&style_dot_bad);
+    lv_style_set_bg_color(&style_dot_bad, COLOR_RED);
+    lv_style_set_shadow_color(&style_dot_bad, COLOR_RED);
+
+    lv_style_init(&style_track);
+    lv_style_set_bg_color(&style_track, COLOR_TEXT_GRAY);
+    lv_style_set_bg_opa(&style_track, LV_OPA_30);
+    lv_style_set_border_width(&style_track, 0);
+    lv_style_set_radius(&style_track, 2);
+    lv_style_init(&style_tick);
+    lv_style_set_bg_color(&style_tick, COLOR_TEXT_GRAY);
+    lv_style_set_bg_opa(&style_tick, LV_OPA_50);
+    lv_style_set_border_width(&style_tick, 0);
+
+    lv_style_init(&style_tank);
+    lv_style_set_bg_color(&style_tank, COLOR_TANK_BG);
+    lv_style_set_radius(&style_tank, 12);
+    lv_style_set_anim_time(&style_tank, 1000);
+    lv_style_init(&style_tank_fill);
+    lv_style_set_bg_color(&style_tank_fill, COLOR_CYAN);
+    lv_style_set_bg_grad_color(&style_tank_fill, COLOR_LIGHT_BLUE);
+    lv_style_set_bg_grad_dir(&style_tank_fill, LV_GRAD_DIR_VER);
+    lv_style_set_radius(&style_tank_fill, 12);
+
+    lv_style_init(&style_accent_bg);
+    lv_style_set_bg_color(&style_accent_bg, COLOR_CYAN);
+
+    lv_style_init(&style_nav_bar);
+    lv_style_set_bg_color(&style_nav_bar, lv_color_hex(0x050A0F));
+    lv_style_set_border_side(&style_nav_bar, LV_BORDER_SIDE_TOP);
+    lv_style_set_border_color(&style_nav_bar, lv_color_hex(0x1A2633));
+}
+
+// Attach the status colours a label can switch between with set_status()
+static void add_status_styles(lv_obj_t * obj, lv_state_t states) {
+    if (states & STATE_ALERT) lv_obj_add_style(obj, &style_alert, STATE_ALERT);
+    if (states & STATE_OK)    lv_obj_add_style(obj, &style_ok, STATE_OK);
+    if (states & STATE_WARN)  lv_obj_add_style(obj, &style_warn, STATE_WARN);
+    if (states & STATE_IDLE)  lv_obj_add_style(obj, &style_idle, STATE_IDLE);
+}
+
+// 0 returns the object to its default look
+static void set_status(lv_obj_t * obj, lv_state_t state) {
+    lv_obj_clear_state(obj, STATE_STATUS & ~state);
+    if (state) lv_obj_add_state(obj, state);
+}
+
 // ======================= HELPERS =======================
 
 static void opa_anim_cb(void * obj, int32_t v) {
@@ -128,45 +1920,453 @@ static void opa_anim_cb(void * obj, int32_t v) {
 static lv_obj_t * create_glass_card(lv_obj_t * parent, int w, int h) {
     lv_obj_t * obj = lv_obj_create(parent);
     lv_obj_set_size(obj, w, h);
-    lv_obj_set_style_bg_color(obj, COLOR_CARD_TOP, 0);
-    lv_obj_set_style_bg_grad_color(obj, COLOR_CARD_BOT, 0);
-    lv_obj_set_style_bg_grad_dir(obj, LV_GRAD_DIR_VER, 0);
-    lv_obj_set_style_border_color(obj, lv_color_white(), 0);
-    lv_obj_set_style_border_opa(obj, LV_OPA_20, 0);
-    lv_obj_set_style_border_width(obj, 1, 0);
-    lv_obj_set_style_radius(obj, 16, 0);
+    lv_obj_add_style(obj, &style_card, 0);
     lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
     return obj;
 }
 
+// Full-width area between the header and the nav bar, hidden until shown.
+// Kept behind the nav bar, which it overlaps, even when created late.
+static lv_obj_t * create_tab_panel(void) {
+    lv_obj_t * obj = lv_obj_create(scr);
+    lv_obj_set_size(obj, 320, 195);
+    lv_obj_align(obj, LV_ALIGN_TOP_MID, 0, 35);
+    lv_obj_add_style(obj, &style_panel, 0);
+    lv_obj_add_flag(obj, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_move_background(obj);
+    return obj;
+}
+
 static void update_water_ui(void) {
     int pct = (water_count * 100) / 8;
     lv_bar_set_value(water_bar, pct, LV_ANIM_ON);
     lv_label_set_text_fmt(label_water_pct, "%d / 8", water_count);
 }
 
-static void switch_tab(int tab_id) {
-    lv_obj_t * tabs[] = {panel_home, panel_stats, panel_settings};
-    for(int i=0; i<3; i++) {
-        if(i == tab_id) {
-            lv_obj_clear_flag(tabs[i], LV_OBJ_FLAG_HIDDEN);
-            lv_anim_t a;
-            lv_anim_init(&a);
-            lv_anim_set_var(&a, tabs[i]);
-            lv_anim_set_values(&a, LV_OPA_TRANSP, LV_OPA_COVER);
-            lv_anim_set_time(&a, 300);
-            lv_anim_set_exec_cb(&a, opa_anim_cb); 
-            lv_anim_start(&a);
-            lv_obj_set_style_text_color(nav_labels[i], COLOR_CYAN, 0);
-        } else {
-            lv_obj_add_flag(tabs[i], LV_OBJ_FLAG_HIDDEN);
-            lv_obj_set_style_text_color(nav_labels[i], COLOR_TEXT_GRAY, 0);
-        }
+static void format_duration(char * buf, int len, uint32_t ms) {
+    uint32_t s = ms / 1000;
+    if (s >= 3600) snprintf(buf, len, "%luh %02lum", (unsigned long)(s / 3600), (unsigned long)(s / 60 % 60));
+    else if (s >= 60) snprintf(buf, len, "%lum %02lus", (unsigned long)(s / 60), (unsigned long)(s % 60));
+    else snprintf(buf, len, "%lus", (unsigned long)s);
+}
+
+static unsigned summary_shown_seq = 0;
+
+static void render_summary(void) {
+    if (!label_summary) return;
+    analytics_view_t v;
+    unsigned s;
+    do {
+        s = seq_read_begin(&analytics_lock);
+        v = analytics_view;
+    } while (seq_read_retry(&analytics_lock, s));
+    summary_shown_seq = s;
+
+    const rollup_t * d = &v.day;
+    if (!d->tracked_ms) {
+        lv_label_set_text(label_summary, "No data yet today");
+        return;
+    }
+    char tracked[16], avg_ep[16], long_ep[16], streak[16], run[16];
+    format_duration(tracked, sizeof(tracked), d->tracked_ms);
+    format_duration(avg_ep, sizeof(avg_ep), d->episodes ? d->slouch_ms / d->episodes : 0);
+    format_duration(long_ep, sizeof(long_ep), d->episode_max_ms);
+    format_duration(streak, sizeof(streak), d->streak_max_ms);
+    format_duration(run, sizeof(run), v.run_ms);
+    float roll = d->roll_s * 1000.0f / d->tracked_ms;
+    uint32_t hour_good = v.hour.tracked_ms ? 100ULL * (v.hour.tracked_ms - v.hour.slouch_ms) / v.hour.tracked_ms : 0;
+    lv_label_set_text_fmt(label_summary,
+        "Good posture: %lu%% of %s\n"
+        "Slouches: %u, avg %s, longest %s\n"
+        "Best good streak: %s\n"
+        "Side lean (roll): %+.1f deg\n"
+        "This hour: %lu%% good, %u slouches\n"
+        "Now: %s for %s",
+        (unsigned long)(100ULL * (d->tracked_ms - d->slouch_ms) / d->tracked_ms), tracked,
+        d->episodes, avg_ep, long_ep, streak,
+        roll,
+        (unsigned long)hour_good, v.hour.episodes,
+        v.run_state == POSTURE_SLOUCH ? "slouching" : "good", run);
+}
+
+// Tabs are built on first visit; see SCREEN MANAGER
+static void switch_tab(int tab_id);
+
+static void update_battery_ui(uint8_t pct) {
+    static uint8_t shown = BATTERY_UNKNOWN;
+    if (pct == shown || pct == BATTERY_UNKNOWN) return;
+    shown = pct;
+
+    const char * sym = pct > 80 ? LV_SYMBOL_BATTERY_FULL :
+                       pct > 55 ? LV_SYMBOL_BATTERY_3 :
+                       pct > 30 ? LV_SYMBOL_BATTERY_2 :
+                       pct > 10 ? LV_SYMBOL_BATTERY_1 : LV_SYMBOL_BATTERY_EMPTY;
+    lv_label_set_text_fmt(label_battery, "%s %d%%", sym, pct);
+    set_status(label_battery, pct > 15 ? 0 : STATE_ALERT);
+}
+
+static void set_header(header_t h) {
+    if (h == shown_header) return;
+    shown_header = h;
+    switch (h) {
+        case HEADER_WATER:
+            lv_label_set_text(label_posture_status, "DRINK WATER!");
+            // Use Orange for high visibility alert
+            set_status(label_posture_status, STATE_WARN);
+            break;
+        case HEADER_SLOUCH:
+            lv_label_set_text(label_posture_status, "SLOUCH DETECTED");
+            set_status(label_posture_status, STATE_ALERT);
+            break;
+        case HEADER_GOOD:
+            lv_label_set_text(label_posture_status, "POSTURE GOOD");
+            set_status(label_posture_status, STATE_OK);
+            break;
+        case HEADER_SEARCHING:
+            lv_label_set_text(label_posture_status, "SEARCHING...");
+            set_status(label_posture_status, STATE_IDLE);
+            break;
+        default:
+            break;
+    }
+}
+
+// Only called when the sender reports a different state
+static void render_posture_state(posture_state_t state) {
+    shown_state = state;
+    set_status(posture_dot, state == POSTURE_SLOUCH ? STATE_ALERT : 0);
+}
+
+// ======================= STRIP CHART =======================
+// The stats chart is a plain object that blits a pixel ring. Each column
+// is rendered into the ring once; a scroll only moves the ring's start, so
+// it costs one new column plus the blit, and an update inside the window
+// invalidates just the columns that changed. Memory stays STRIP_COLS x
+// STRIP_H pixels whatever the zoom, where lv_chart redrew every point.
+#define STRIP_H        120
+#define STRIP_MAX_DEG  60      // Top of the chart
+
+static struct {
+    lv_color_t * px;           // STRIP_H rows of STRIP_COLS
+    lv_img_dsc_t img;
+    int head;                  // Ring column holding the oldest column shown
+    int32_t end;               // chart_end shown, -1 to redraw everything
+    uint8_t zoom;
+    strip_col_t shown[STRIP_COLS];
+} strip;
+
+static unsigned chart_shown_seq = 0;
+
+static int strip_y(int deg) {
+    if (deg > STRIP_MAX_DEG) deg = STRIP_MAX_DEG;
+    return STRIP_H - 1 - deg * (STRIP_H - 1) / STRIP_MAX_DEG;
+}
+
+// Mean as a 2 px line over the min/max envelope, grid every 15 degrees
+static void strip_render_col(int x, strip_col_t c) {
+    lv_color_t env = lv_color_mix(COLOR_CYAN, COLOR_TANK_BG, LV_OPA_30);
+    int top = STRIP_H, bottom = -1, mean = -2;
+    if (c.mean != STRIP_NONE) {
+        top = strip_y(c.hi);
+        bottom = strip_y(c.lo);
+        mean = strip_y(c.mean);
+    }
+    lv_color_t * p = strip.px + x;
+    for (int y = 0; y < STRIP_H; y++, p += STRIP_COLS) {
+        if (y == mean || y == mean - 1) *p = COLOR_CYAN;
+        else if (y >= top && y <= bottom) *p = env;
+        else if (y == strip_y(15) || y == strip_y(30) || y == strip_y(45)) *p = COLOR_CARD_TOP;
+        else *p = COLOR_TANK_BG;
     }
 }
 
+static void strip_draw_cb(lv_event_t * e) {
+    if (!strip.px) return;
+    lv_draw_ctx_t * ctx = lv_event_get_draw_ctx(e);
+    lv_area_t a, clip;
+    lv_obj_get_content_coords(lv_event_get_target(e), &a);
+    if (!_lv_area_intersect(&clip, &a, ctx->clip_area)) return;
+    const lv_area_t * clip_old = ctx->clip_area;
+    ctx->clip_area = &clip;
+    // The ring drawn twice side by side, shifted so its head lands on the left edge
+    lv_draw_img_dsc_t d;
+    lv_draw_img_dsc_init(&d);
+    lv_area_t at = { a.x1 - strip.head, a.y1, a.x1 - strip.head + STRIP_COLS - 1, a.y1 + STRIP_H - 1 };
+    lv_draw_img(ctx, &d, &at, &strip.img);
+    lv_area_move(&at, STRIP_COLS, 0);
+    lv_draw_img(ctx, &d, &at, &strip.img);
+    ctx->clip_area = clip_old;
+}
+
+static void strip_title(void) {
+    static const char * spans[] = { "4 HOURS", "12 HOURS", "24 HOURS" };
+    lv_label_set_text_fmt(label_chart_title, "LAST %s (Posture Score)",
+                          spans[atomic_load(&chart_zoom_req) % sizeof(STRIP_ZOOM_MIN)]);
+}
+
+// Tap the chart for the next zoom; the radio core re-exports within a second
+static void strip_zoom_cb(lv_event_t * e) {
+    atomic_store(&chart_zoom_req, (atomic_load(&chart_zoom_req) + 1) % sizeof(STRIP_ZOOM_MIN));
+    strip_title();
+}
+
+static lv_obj_t * strip_create(lv_obj_t * parent) {
+    lv_obj_t * obj = lv_obj_create(parent);
+    lv_obj_remove_style_all(obj);
+    lv_obj_set_size(obj, STRIP_COLS, STRIP_H);
+    lv_obj_add_event_cb(obj, strip_draw_cb, LV_EVENT_DRAW_MAIN, NULL);
+    lv_obj_add_event_cb(obj, strip_zoom_cb, LV_EVENT_CLICKED, NULL);
+
+    size_t bytes = STRIP_COLS * STRIP_H * sizeof(lv_color_t);
+    strip.px = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+    if (!strip.px) strip.px = heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+    if (!strip.px) ESP_LOGE("UI", "No memory for the chart");
+    strip.img = (lv_img_dsc_t) {
+        .header.cf = LV_IMG_CF_TRUE_COLOR,
+        .header.w = STRIP_COLS,
+        .header.h = STRIP_H,
+        .data_size = bytes,
+        .data = (const uint8_t *)strip.px,
+    };
+    strip.end = -1;
+    return obj;
+}
+
+static void strip_free(void) {
+    lv_img_cache_invalidate_src(&strip.img);
+    heap_caps_free(strip.px);
+    strip.px = NULL;
+}
+
+static void refresh_chart(void) {
+    PROF_SCOPE(PROF_CHART);
+    static strip_col_t cols[STRIP_COLS];
+    int32_t end;
+    uint8_t zoom;
+    unsigned s;
+    do {
+        s = seq_read_begin(&chart_lock);
+        memcpy(cols, chart_cols, sizeof(cols));
+        end = chart_end;
+        zoom = chart_zoom;
+    } while (seq_read_retry(&chart_lock, s));
+    chart_shown_seq = s;
+    if (!strip.px) return;
+
+    // What is now column i was column i + shift last time
+    int32_t shift = end - strip.end;
+    bool all = strip.end < 0 || zoom != strip.zoom || shift < 0 || shift >= STRIP_COLS;
+    if (all) {
+        shift = 0;
+        strip.head = 0;
+    }
+    strip.head = (strip.head + shift) % STRIP_COLS;
+    int first = STRIP_COLS, last = -1;
+    for (int i = 0; i < STRIP_COLS; i++) {
+        if (!all && i + shift < STRIP_COLS
+            && !memcmp(&cols[i], &strip.shown[i + shift], sizeof(cols[i]))) continue;
+        strip_render_col((strip.head + i) % STRIP_COLS, cols[i]);
+        if (i < first) first = i;
+        last = i;
+    }
+    memcpy(strip.shown, cols, sizeof(cols));
+    strip.end = end;
+    strip.zoom = zoom;
+
+    if (all || shift) {
+        lv_obj_invalidate(chart_posture);      // Everything moved, but only as a blit
+    } else if (last >= 0) {
+        lv_area_t a;
+        lv_obj_get_content_coords(chart_posture, &a);
+        a.x2 = a.x1 + last;
+        a.x1 += first;
+        lv_obj_invalidate_area(chart_posture, &a);
+    }
+}
+
+// ======================= DISPLAY BENCHMARK =======================
+
+// LVGL reports each finished refresh: time spent rendering and flushing, and
+// how many pixels went out. Only counted while a benchmark runs.
+static void disp_monitor_cb(lv_disp_drv_t * drv, uint32_t time_ms, uint32_t px) {
+    static bool first = true;
+    if (first) {
+        first = false;
+        boot_phase("first frame", 0);
+    }
+    prof_record(PROF_RENDER, time_ms * 1000);
+    if (!bench.running) return;
+    bench.frames++;
+    bench.time_ms += time_ms;
+    bench.px += px;
+    if (time_ms > bench.max_ms) bench.max_ms = time_ms;
+}
+
+static void dot_anim_cb(void * obj, int32_t v) {
+    lv_obj_align_to((lv_obj_t *)obj, spine_track, LV_ALIGN_CENTER, 0, v);
+}
+
+static void bench_close_cb(lv_event_t * e) {
+    lv_obj_del(lv_event_get_target(e));
+}
+
+static void bench_step_cb(lv_timer_t * t) {
+    if (esp_timer_get_time() - bench.start_us < DISPLAY_BENCH_MS * 1000LL) {
+        bench.tab = (bench.tab + 1) % TAB_COUNT;
+        switch_tab(bench.tab);
+        return;
+    }
+    bench.running = false;
+    lv_timer_del(t);
+    lv_anim_del(posture_dot, dot_anim_cb);
+    switch_tab(0);
+
+    float secs = DISPLAY_BENCH_MS / 1000.0f;
+    uint32_t avg_ms = bench.frames ? bench.time_ms / bench.frames : 0;
+    ESP_LOGI("BENCH", "buf=%d lines x%d %s: %.1f fps, refresh avg %lu ms max %lu ms, %.0f kpx/s",
+             DISPLAY_BUF_LINES, DISPLAY_DOUBLE_BUF ? 2 : 1, DISPLAY_BUF_PSRAM ? "PSRAM" : "internal",
+             bench.frames / secs, (unsigned long)avg_ms, (unsigned long)bench.max_ms, bench.px / secs / 1000);
+
+    lv_obj_t * card = create_glass_card(lv_layer_top(), 240, 110);
+    lv_obj_center(card);
+    lv_obj_add_event_cb(card, bench_close_cb, LV_EVENT_CLICKED, NULL);
+    lv_obj_t * lbl = lv_label_create(card);
+    lv_obj_add_style(lbl, &style_label_white, 0);
+    lv_obj_add_style(lbl, &style_font_12, 0);
+    lv_label_set_text_fmt(lbl, "%d lines x%d, %s\n%.1f FPS\nrefresh avg %lu ms / max %lu ms\n%.0f kpx/s",
+                          DISPLAY_BUF_LINES, DISPLAY_DOUBLE_BUF ? 2 : 1, DISPLAY_BUF_PSRAM ? "PSRAM" : "internal",
+                          bench.frames / secs, (unsigned long)avg_ms, (unsigned long)bench.max_ms,
+                          bench.px / secs / 1000);
+    lv_obj_center(lbl);
+}
+
+// Worst case the UI produces: the posture dot sweeping its track while
+// tabs fade in back to back.
+static void start_display_benchmark(void) {
+    if (bench.running) return;
+    memset(&bench, 0, sizeof(bench));
+    bench.running = true;
+    bench.start_us = esp_timer_get_time();
+
+    lv_anim_t a;
+    lv_anim_init(&a);
+    lv_anim_set_var(&a, posture_dot);
+    lv_anim_set_values(&a, -45, 45);
+    lv_anim_set_time(&a, 700);
+    lv_anim_set_playback_time(&a, 700);
+    lv_anim_set_repeat_count(&a, LV_ANIM_REPEAT_INFINITE);
+    lv_anim_set_exec_cb(&a, dot_anim_cb);
+    lv_anim_start(&a);
+
+    lv_timer_create(bench_step_cb, DISPLAY_BENCH_STEP, NULL);
+}
+
+// ======================= DIAGNOSTICS =======================
+
+typedef struct {
+    size_t int_free, int_largest, int_min;       // Internal RAM, bytes
+    size_t psram_free, psram_largest, psram_min;
+    uint32_t lv_used, lv_largest;                // LVGL heap, bytes
+    uint8_t lv_frag;                             // %
+    int timers, objects;
+    uint32_t ingest_stack;                       // Words never touched
+} diag_t;
+
+static diag_t diag;          // Latest sample
+static diag_t diag_worst;    // Lowest free / highest use seen since boot
+static int diag_timer_base = -1;
+
+static int count_objects(lv_obj_t * obj) {
+    int n = 1;
+    uint32_t cnt = lv_obj_get_child_cnt(obj);
+    for (uint32_t i = 0; i < cnt; i++) n += count_objects(lv_obj_get_child(obj, i));
+    return n;
+}
+
+static void diag_render(void) {
+    if (!label_diag) return;
+    lv_label_set_text_fmt(label_diag,
+        "Internal: %u free, %u block, low %u\n"
+        "PSRAM: %u free, %u block\n"
+        "LVGL: %lu used, max %lu\n"
+        "LVGL frag: %d%%\n"
+        "Timers: %d, max %d\n"
+        "Objects: %d, max %d\n"
+        "Ingest stack: %lu words left",
+        (unsigned)diag.int_free, (unsigned)diag.int_largest, (unsigned)diag.int_min,
+        (unsigned)diag.psram_free, (unsigned)diag.psram_largest,
+        (unsigned long)diag.lv_used, (unsigned long)diag_worst.lv_used,
+        diag.lv_frag, diag.timers, diag_worst.timers, diag.objects, diag_worst.objects,
+        (unsigned long)diag.ingest_stack);
+
+#if PROFILE_ENABLED
+    static char buf[PROF_MAX_TASKS * 24];
+    int n = prof_format(buf, sizeof(buf));
+    prof_task_stats(buf + n, sizeof(buf) - n);
+    lv_label_set_text(label_prof, buf);
+#endif
+}
+
+// UI core, every DIAG_SAMPLE_MS. LVGL counters are only safe to walk here.
+static void diag_sample_cb(lv_timer_t * t) {
+    PROF_SCOPE(PROF_DIAG);
+    static int64_t last_log_ms = -DIAG_LOG_MS;
+    diag_t d;
+    d.int_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    d.int_largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    d.int_min = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    d.psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    d.psram_largest = heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM);
+    d.psram_min = heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM);
+
+    lv_mem_monitor_t mon;
+    lv_mem_monitor(&mon);
+    d.lv_used = mon.total_size - mon.free_size;
+    d.lv_largest = mon.free_biggest_size;
+    d.lv_frag = mon.frag_pct;
+
+    d.timers = 0;
+    for (lv_timer_t * tm = lv_timer_get_next(NULL); tm; tm = lv_timer_get_next(tm)) d.timers++;
+    d.objects = count_objects(lv_scr_act()) + count_objects(lv_layer_top()) + count_objects(lv_layer_sys());
+    d.ingest_stack = ingest_task_handle ? uxTaskGetStackHighWaterMark(ingest_task_handle) : 0;
+
+    if (diag_timer_base < 0) {
+        diag_timer_base = d.timers;
+        diag_worst = d;
+    }
+    if (d.int_free < diag_worst.int_free) diag_worst.int_free = d.int_free;
+    if (d.int_largest < diag_worst.int_largest) diag_worst.int_largest = d.int_largest;
+    if (d.psram_free < diag_worst.psram_free) diag_worst.psram_free = d.psram_free;
+    if (d.lv_used > diag_worst.lv_used) diag_worst.lv_used = d.lv_used;
+    if (d.lv_frag > diag_worst.lv_frag) diag_worst.lv_frag = d.lv_frag;
+    if (d.timers > diag_worst.timers) diag_worst.timers = d.timers;
+    if (d.objects > diag_worst.objects) diag_worst.objects = d.objects;
+    diag = d;
+
+    if (d.timers > diag_timer_base + DIAG_TIMER_SLACK) {
+        ESP_LOGW("DIAG", "LVGL timers grew from %d to %d, something is not deleting its timer",
+                 diag_timer_base, d.timers);
+    }
+
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    if (now_ms - last_log_ms >= DIAG_LOG_MS) {
+        last_log_ms = now_ms;
+        ESP_LOGI("DIAG", "int %u/%u blk (low %u) psram %u/%u blk (low %u) lvgl %lu used %d%% frag, %d timers, %d objs, ingest stack %lu",
+                 (unsigned)d.int_free, (unsigned)d.int_largest, (unsigned)d.int_min,
+                 (unsigned)d.psram_free, (unsigned)d.psram_largest, (unsigned)d.psram_min,
+                 (unsigned long)d.lv_used, d.lv_frag, d.timers, d.objects, (unsigned long)d.ingest_stack);
+    }
+
+    if (panel_diag && !lv_obj_has_flag(panel_diag, LV_OBJ_FLAG_HIDDEN)) diag_render();
+    prof_poll(now_ms);
+}
+
 // ======================= CALLBACKS =======================
 
+static void header_long_press_cb(lv_event_t * e) {
+    start_display_benchmark();
+}
+
 static void nav_click_cb(lv_event_t * e) {
     switch_tab((int)(size_t)lv_event_get_user_data(e));
 }
@@ -175,7 +2375,7 @@ static void btn_water_cb(lv_event_t * e) {
     lv_event_code_t code = lv_event_get_code(e);
     if(code == LV_EVENT_SHORT_CLICKED) {
         if (water_count < 8) { water_count++; }
-        water_timer_ticks = 0; 
+        water_due_ms = esp_timer_get_time() / 1000 + WATER_REMINDER_MS;
         water_alert_active = false;
         update_water_ui();
     } else if (code == LV_EVENT_LONG_PRESSED) {
@@ -185,93 +2385,165 @@ static void btn_water_cb(lv_event_t * e) {
 
 static void cal_reset_timer_cb(lv_timer_t * t) {
     lv_label_set_text(lbl_cal, LV_SYMBOL_REFRESH " CALIBRATE");
-    lv_obj_set_style_text_color(lbl_cal, COLOR_CYAN, 0);
+    set_status(lbl_cal, 0);
     lv_obj_clear_state(btn_cal, LV_STATE_DISABLED);
+    lv_timer_del(t);
 }
 
 static void btn_calibrate_cb(lv_event_t * e) {
     send_calibration_command();
     lv_label_set_text(lbl_cal, "HOLD STILL...");
-    lv_obj_set_style_text_color(lbl_cal, COLOR_ORANGE, 0);
+    set_status(lbl_cal, STATE_WARN);
     lv_obj_add_state(btn_cal, LV_STATE_DISABLED);
     lv_timer_create(cal_reset_timer_cb, 3000, NULL);
 }
 
 static void toggle_vibration_cb(lv_event_t * e) {
-    bool state = lv_obj_has_state(sw_vibration, LV_STATE_CHECKED);
-    send_vibration_setting(state);
+    vibration_on = lv_obj_has_state(sw_vibration, LV_STATE_CHECKED);
+    send_vibration_setting(vibration_on);
+}
+
+static void slider_angle_cb(lv_event_t * e) {
+    int deg = lv_slider_get_value(slider_angle);
+    lv_label_set_text_fmt(lbl_angle_val, "%d\xC2\xB0", deg);
+    if (lv_event_get_code(e) != LV_EVENT_RELEASED) return;
+
+    sender_cfg.enter_deg = deg;
+    sender_cfg.exit_deg = deg - DET_HYSTERESIS_DEG;
+    atomic_store(&sender_cfg_dirty, true);
+}
+
+static const char * capture_label(uint8_t mode) {
+    switch (mode) {
+        case CAPTURE_RAW:      return "RAW 1 kHz";
+        case CAPTURE_FILTERED: return "100 Hz";
+        default:               return "OFF";
+    }
+}
+
+// Off -> raw -> filtered -> off; the sender's defaults give 1 kHz raw and
+// 100 Hz filtered
+static void btn_capture_cb(lv_event_t * e) {
+    capture_mode = (capture_mode + 1) % (CAPTURE_FILTERED + 1);
+    post_command(CMD_CAPTURE, capture_mode);
+    lv_label_set_text(lbl_capture, capture_label(capture_mode));
+}
+
+static const uint8_t SCREEN_OFF_CHOICES[] = { 1, 5, 15, 0 };    // Minutes, 0 = never
+
+static void screen_off_label(lv_obj_t * lbl) {
+    if (screen_off_min) lv_label_set_text_fmt(lbl, "%u min", screen_off_min);
+    else lv_label_set_text(lbl, "NEVER");
+}
+
+static void btn_screen_off_cb(lv_event_t * e) {
+    int n = sizeof(SCREEN_OFF_CHOICES), i = 0;
+    while (i < n - 1 && SCREEN_OFF_CHOICES[i] != screen_off_min) i++;
+    screen_off_min = SCREEN_OFF_CHOICES[(i + 1) % n];
+    screen_off_label(lv_obj_get_child(lv_event_get_target(e), 0));
+    atomic_store(&display_cfg_dirty, true);
+}
+
+static void tx_policy_label(void) {
+    static const char * names[] = { "STREAM", "EVENT", "BATCH" };
+    lv_label_set_text(lbl_tx_policy, sender_cfg.tx_policy <= TX_POLICY_BATCH ? names[sender_cfg.tx_policy] : "?");
+}
+
+static void btn_tx_policy_cb(lv_event_t * e) {
+    sender_cfg.tx_policy = (sender_cfg.tx_policy + 1) % (TX_POLICY_BATCH + 1);
+    tx_policy_label();
+    atomic_store(&sender_cfg_dirty, true);
+}
+
+static void btn_ota_cb(lv_event_t * e) {
+    post_command(CMD_OTA_BEGIN, 0);
 }
 
 static void toggle_wifi_cb(lv_event_t * e) {
-    bool state = lv_obj_has_state(sw_wifi, LV_STATE_CHECKED);
-    if(state) {
+    radio_on = lv_obj_has_state(sw_wifi, LV_STATE_CHECKED);
+    if(radio_on) {
         lv_label_set_text(lbl_wifi_status, "Offline Mode (Ch 1)");
+        set_status(lbl_wifi_status, 0);
         esp_wifi_start();
         esp_wifi_set_channel(1, WIFI_SECOND_CHAN_NONE);
     } else {
         esp_wifi_stop();
         lv_label_set_text(lbl_wifi_status, "Radio Off");
-        lv_obj_set_style_text_color(lbl_wifi_status, COLOR_TEXT_GRAY, 0);
-        lv_obj_set_style_text_color(label_wifi_icon, COLOR_TEXT_GRAY, 0);
+        set_status(lbl_wifi_status, STATE_IDLE);
+        set_status(label_wifi_icon, 0);
+    }
+}
+
+// Settings tab only: progress of a sender update run by the radio core
+static void ota_render(bool force) {
+    static int shown_state = -1, shown_pct = -1, shown_kbps = -1;
+    if (!lbl_ota) return;
+    int st = atomic_load(&ota_ui_state), pct = atomic_load(&ota_ui_pct), kbps = atomic_load(&ota_ui_kbps);
+    if (!force && st == shown_state && pct == shown_pct && kbps == shown_kbps) return;
+    shown_state = st; shown_pct = pct; shown_kbps = kbps;
+
+    switch (st) {
+        case OTA_UI_RUNNING:
+            lv_label_set_text_fmt(lbl_ota, "Updating %d%%, %d kB/s", pct, kbps);
+            set_status(lbl_ota, 0);
+            lv_obj_add_state(btn_ota, LV_STATE_DISABLED);
+            break;
+        case OTA_UI_DONE:
+            lv_label_set_text(lbl_ota, "Updated, sender restarting");
+            set_status(lbl_ota, STATE_OK);
+            lv_obj_clear_state(btn_ota, LV_STATE_DISABLED);
+            break;
+        case OTA_UI_FAILED:
+            lv_label_set_text_fmt(lbl_ota, "Stopped at %d%%, tap to resume", pct);
+            set_status(lbl_ota, STATE_ALERT);
+            lv_obj_clear_state(btn_ota, LV_STATE_DISABLED);
+            break;
+        default:
+            break;
     }
 }
 
 // ======================= UI BUILDERS =======================
 
 void build_home_tab(void) {
-    panel_home = lv_obj_create(scr);
-    lv_obj_set_size(panel_home, 320, 195);
-    lv_obj_align(panel_home, LV_ALIGN_TOP_MID, 0, 35);
-    lv_obj_set_style_bg_opa(panel_home, 0, 0);
-    lv_obj_set_style_border_width(panel_home, 0, 0);
+    panel_home = create_tab_panel();
 
     // --- LEFT CARD ---
     lv_obj_t * p_left = create_glass_card(panel_home, 180, 165);
     lv_obj_align(p_left, LV_ALIGN_TOP_LEFT, 5, 0);
 
     label_pitch_val = lv_label_create(p_left);
-    lv_obj_set_style_text_color(label_pitch_val, COLOR_TEXT_GRAY, 0);
-    lv_obj_set_style_text_font(label_pitch_val, &lv_font_montserrat_12, 0);
+    lv_obj_add_style(label_pitch_val, &style_label_muted, 0);
     lv_obj_align(label_pitch_val, LV_ALIGN_TOP_LEFT, 5, 5);
     lv_label_set_text(label_pitch_val, "P: --");
 
     spine_track = lv_obj_create(p_left);
     lv_obj_set_size(spine_track, 4, 100); 
-    lv_obj_set_style_bg_color(spine_track, COLOR_TEXT_GRAY, 0);
-    lv_obj_set_style_bg_opa(spine_track, LV_OPA_30, 0);
-    lv_obj_set_style_border_width(spine_track, 0, 0);
-    lv_obj_set_style_radius(spine_track, 2, 0);
+    lv_obj_add_style(spine_track, &style_track, 0);
     lv_obj_align(spine_track, LV_ALIGN_CENTER, 0, -15); 
 
     lv_obj_t * dash = lv_obj_create(p_left);
     lv_obj_set_size(dash, 20, 2);
-    lv_obj_set_style_bg_color(dash, COLOR_TEXT_GRAY, 0);
-    lv_obj_set_style_bg_opa(dash, LV_OPA_50, 0);
-    lv_obj_set_style_border_width(dash, 0, 0);
+    lv_obj_add_style(dash, &style_tick, 0);
     lv_obj_align(dash, LV_ALIGN_CENTER, 0, -15); 
 
     posture_dot = lv_obj_create(p_left);
     lv_obj_set_size(posture_dot, 20, 20); 
-    lv_obj_set_style_radius(posture_dot, LV_RADIUS_CIRCLE, 0);
-    lv_obj_set_style_bg_color(posture_dot, COLOR_CYAN, 0);
-    lv_obj_set_style_border_width(posture_dot, 2, 0);
-    lv_obj_set_style_border_color(posture_dot, lv_color_white(), 0);
-    lv_obj_set_style_shadow_width(posture_dot, 10, 0);
-    lv_obj_set_style_shadow_color(posture_dot, COLOR_CYAN, 0);
+    lv_obj_add_style(posture_dot, &style_dot_good, 0);
+    lv_obj_add_style(posture_dot, &style_dot_bad, STATE_ALERT);
     lv_obj_align_to(posture_dot, spine_track, LV_ALIGN_CENTER, 0, 0);
 
     btn_cal = lv_btn_create(p_left);
     lv_obj_set_size(btn_cal, 140, 30);
     lv_obj_align(btn_cal, LV_ALIGN_BOTTOM_MID, 0, -5);
-    lv_obj_set_style_bg_opa(btn_cal, LV_OPA_TRANSP, 0);      
-    lv_obj_set_style_shadow_width(btn_cal, 0, 0);            
-    lv_obj_set_style_border_width(btn_cal, 0, 0);            
+    lv_obj_add_style(btn_cal, &style_btn_flat, 0);
     lv_obj_add_event_cb(btn_cal, btn_calibrate_cb, LV_EVENT_CLICKED, NULL);
 
     lbl_cal = lv_label_create(btn_cal);
     lv_label_set_text(lbl_cal, LV_SYMBOL_REFRESH " CALIBRATE");
-    lv_obj_set_style_text_font(lbl_cal, &lv_font_montserrat_12, 0);
-    lv_obj_set_style_text_color(lbl_cal, COLOR_CYAN, 0);
+    lv_obj_add_style(lbl_cal, &style_label_accent, 0);
+    lv_obj_add_style(lbl_cal, &style_font_12, 0);
+    add_status_styles(lbl_cal, STATE_WARN);
     lv_obj_center(lbl_cal);
 
     // --- RIGHT CARD (Water) ---
@@ -280,260 +2552,564 @@ void build_home_tab(void) {
 
     lv_obj_t * lbl_title = lv_label_create(p_right);
     lv_label_set_text(lbl_title, "WATER");
-    lv_obj_set_style_text_font(lbl_title, &lv_font_montserrat_12, 0); 
-    lv_obj_set_style_text_color(lbl_title, COLOR_TEXT_GRAY, 0);
+    lv_obj_add_style(lbl_title, &style_label_muted, 0);
     lv_obj_align(lbl_title, LV_ALIGN_TOP_MID, 0, 5);
 
     water_bar = lv_bar_create(p_right);
     lv_obj_set_size(water_bar, 60, 90); 
     lv_obj_align(water_bar, LV_ALIGN_TOP_MID, 0, 25);
-    lv_obj_set_style_bg_color(water_bar, COLOR_TANK_BG, LV_PART_MAIN); 
-    lv_obj_set_style_radius(water_bar, 12, LV_PART_MAIN);
-    lv_obj_set_style_bg_color(water_bar, COLOR_CYAN, LV_PART_INDICATOR);
-    lv_obj_set_style_bg_grad_color(water_bar, COLOR_LIGHT_BLUE, LV_PART_INDICATOR);
-    lv_obj_set_style_bg_grad_dir(water_bar, LV_GRAD_DIR_VER, LV_PART_INDICATOR);
-    lv_obj_set_style_radius(water_bar, 12, LV_PART_INDICATOR);
-    lv_obj_set_style_anim_time(water_bar, 1000, 0);
+    lv_obj_add_style(water_bar, &style_tank, LV_PART_MAIN);
+    lv_obj_add_style(water_bar, &style_tank_fill, LV_PART_INDICATOR);
 
     lv_obj_t * icon_drop = lv_label_create(p_right);
     lv_label_set_text(icon_drop, LV_SYMBOL_TINT);
-    lv_obj_set_style_text_color(icon_drop, lv_color_white(), 0);
+    lv_obj_add_style(icon_drop, &style_label_white, 0);
     lv_obj_align_to(icon_drop, water_bar, LV_ALIGN_TOP_MID, 0, 15);
 
     label_water_pct = lv_label_create(p_right);
-    lv_obj_set_style_text_font(label_water_pct, &lv_font_montserrat_20, 0); 
-    lv_obj_set_style_text_color(label_water_pct, lv_color_white(), 0);
+    lv_obj_add_style(label_water_pct, &style_label_white, 0);
+    lv_obj_add_style(label_water_pct, &style_font_20, 0);
     lv_obj_align_to(label_water_pct, water_bar, LV_ALIGN_CENTER, 0, 5);
 
     // --- FIX: VISIBLE WATER TIMER ---
     label_water_timer = lv_label_create(p_right);
     lv_label_set_text(label_water_timer, "60:00");
     // Changed font to 14 and Color to White for better visibility
-    lv_obj_set_style_text_font(label_water_timer, &lv_font_montserrat_14, 0);
-    lv_obj_set_style_text_color(label_water_timer, lv_color_white(), 0);
+    lv_obj_add_style(label_water_timer, &style_label_white, 0);
+    lv_obj_add_style(label_water_timer, &style_font_14, 0);
     lv_obj_align_to(label_water_timer, water_bar, LV_ALIGN_BOTTOM_MID, 0, -8);
 
     lv_obj_t * btn_add = lv_btn_create(p_right);
     lv_obj_set_size(btn_add, 50, 40); 
     lv_obj_align(btn_add, LV_ALIGN_BOTTOM_MID, 0, -5);
-    lv_obj_set_style_bg_opa(btn_add, LV_OPA_TRANSP, 0); 
+    lv_obj_add_style(btn_add, &style_btn_flat, 0);
     lv_obj_add_event_cb(btn_add, btn_water_cb, LV_EVENT_ALL, NULL); 
     
     lv_obj_t * lbl_add = lv_label_create(btn_add);
     lv_label_set_text(lbl_add, "+");
-    lv_obj_set_style_text_font(lbl_add, &lv_font_montserrat_20, 0);
-    lv_obj_set_style_text_color(lbl_add, COLOR_CYAN, 0);
+    lv_obj_add_style(lbl_add, &style_label_accent, 0);
+    lv_obj_add_style(lbl_add, &style_font_20, 0);
     lv_obj_center(lbl_add);
 
     update_water_ui();
 }
 
 void build_stats_tab(void) {
-    panel_stats = lv_obj_create(scr);
-    lv_obj_set_size(panel_stats, 320, 195);
-    lv_obj_align(panel_stats, LV_ALIGN_TOP_MID, 0, 35);
-    lv_obj_set_style_bg_opa(panel_stats, 0, 0);
-    lv_obj_set_style_border_width(panel_stats, 0, 0);
-    lv_obj_add_flag(panel_stats, LV_OBJ_FLAG_HIDDEN);
+    panel_stats = create_tab_panel();
+    lv_obj_set_style_pad_all(panel_stats, 0, 0);
+    lv_obj_set_scroll_dir(panel_stats, LV_DIR_VER);
+    lv_obj_set_scroll_snap_y(panel_stats, LV_SCROLL_SNAP_CENTER);
 
     lv_obj_t * card = create_glass_card(panel_stats, 280, 165);
-    lv_obj_center(card);
+    lv_obj_align(card, LV_ALIGN_TOP_MID, 0, 15);
 
-    lv_obj_t * title = lv_label_create(card);
-    lv_label_set_text(title, "LAST 1 HOUR (Posture Score)");
-    lv_obj_set_style_text_color(title, COLOR_TEXT_GRAY, 0);
-    lv_obj_set_style_text_font(title, &lv_font_montserrat_12, 0);
-    lv_obj_align(title, LV_ALIGN_TOP_LEFT, 10, 5);
+    label_chart_title = lv_label_create(card);
+    strip_title();
+    lv_obj_add_style(label_chart_title, &style_label_muted, 0);
+    lv_obj_align(label_chart_title, LV_ALIGN_TOP_LEFT, 10, 5);
 
-    chart_posture = lv_chart_create(card);
-    lv_obj_set_size(chart_posture, 260, 120);
+    // Tap to zoom out; the stats tab scrolls vertically, so no drag is needed
+    chart_posture = strip_create(card);
     lv_obj_align(chart_posture, LV_ALIGN_CENTER, 0, 10);
-    lv_chart_set_type(chart_posture, LV_CHART_TYPE_LINE); 
-    
-    lv_chart_set_range(chart_posture, LV_CHART_AXIS_PRIMARY_Y, 0, 60);
-    lv_chart_set_point_count(chart_posture, 60);
-    
-    lv_obj_set_style_bg_opa(chart_posture, 0, 0); 
-    lv_obj_set_style_border_width(chart_posture, 0, 0);
-    lv_obj_set_style_line_width(chart_posture, 2, LV_PART_ITEMS);
-    lv_obj_set_style_size(chart_posture, 0, 0, LV_PART_INDICATOR); 
 
-    ser_posture = lv_chart_add_series(chart_posture, COLOR_CYAN, LV_CHART_AXIS_PRIMARY_Y);
-    
-    for(int i=0; i<60; i++) {
-        lv_chart_set_next_value(chart_posture, ser_posture, 0);
-    }
+    // Summary below the chart; swipe up to reach it
+    lv_obj_t * sum = create_glass_card(panel_stats, 280, 165);
+    lv_obj_align(sum, LV_ALIGN_TOP_MID, 0, 195);
+
+    lv_obj_t * sum_title = lv_label_create(sum);
+    lv_label_set_text(sum_title, "TODAY");
+    lv_obj_add_style(sum_title, &style_label_muted, 0);
+    lv_obj_align(sum_title, LV_ALIGN_TOP_LEFT, 10, 5);
+
+    label_summary = lv_label_create(sum);
+    lv_obj_add_style(label_summary, &style_label_white, 0);
+    lv_obj_add_style(label_summary, &style_font_12, 0);
+    lv_obj_align(label_summary, LV_ALIGN_TOP_LEFT, 10, 25);
 }
 
 void build_settings_tab(void) {
-    panel_settings = lv_obj_create(scr);
-    lv_obj_set_size(panel_settings, 320, 195);
-    lv_obj_align(panel_settings, LV_ALIGN_TOP_MID, 0, 35);
-    lv_obj_set_style_bg_opa(panel_settings, 0, 0);
-    lv_obj_set_style_border_width(panel_settings, 0, 0);
-    lv_obj_add_flag(panel_settings, LV_OBJ_FLAG_HIDDEN);
+    panel_settings = create_tab_panel();
 
     lv_obj_t * card = create_glass_card(panel_settings, 280, 165);
     lv_obj_center(card);
+    lv_obj_add_flag(card, LV_OBJ_FLAG_SCROLLABLE);   // More rows than fit
 
     // Wi-Fi
     lv_obj_t * lbl_wifi = lv_label_create(card);
     lv_label_set_text(lbl_wifi, "Offline Link");
-    lv_obj_set_style_text_color(lbl_wifi, lv_color_white(), 0);
+    lv_obj_add_style(lbl_wifi, &style_label_white, 0);
     lv_obj_align(lbl_wifi, LV_ALIGN_TOP_LEFT, 20, 15);
     sw_wifi = lv_switch_create(card);
     lv_obj_align(sw_wifi, LV_ALIGN_TOP_RIGHT, -20, 10);
-    lv_obj_add_state(sw_wifi, LV_STATE_CHECKED); 
-    lv_obj_set_style_bg_color(sw_wifi, COLOR_CYAN, LV_PART_INDICATOR | LV_STATE_CHECKED);
+    if (radio_on) lv_obj_add_state(sw_wifi, LV_STATE_CHECKED);
+    lv_obj_add_style(sw_wifi, &style_accent_bg, LV_PART_INDICATOR | LV_STATE_CHECKED);
     lv_obj_add_event_cb(sw_wifi, toggle_wifi_cb, LV_EVENT_VALUE_CHANGED, NULL);
 
     lbl_wifi_status = lv_label_create(card);
-    lv_label_set_text(lbl_wifi_status, "Offline Mode (Ch 1)");
-    lv_obj_set_style_text_color(lbl_wifi_status, COLOR_CYAN, 0);
-    lv_obj_set_style_text_font(lbl_wifi_status, &lv_font_montserrat_12, 0);
+    lv_label_set_text(lbl_wifi_status, radio_on ? "Offline Mode (Ch 1)" : "Radio Off");
+    lv_obj_add_style(lbl_wifi_status, &style_label_accent, 0);
+    lv_obj_add_style(lbl_wifi_status, &style_font_12, 0);
+    add_status_styles(lbl_wifi_status, STATE_IDLE);
+    if (!radio_on) set_status(lbl_wifi_status, STATE_IDLE);
     lv_obj_align(lbl_wifi_status, LV_ALIGN_TOP_LEFT, 20, 35);
 
     // Vibration 
     lv_obj_t * lbl_vib = lv_label_create(card);
     lv_label_set_text(lbl_vib, "Vibration");
-    lv_obj_set_style_text_color(lbl_vib, lv_color_white(), 0);
+    lv_obj_add_style(lbl_vib, &style_label_white, 0);
     lv_obj_align(lbl_vib, LV_ALIGN_TOP_LEFT, 20, 60);
     sw_vibration = lv_switch_create(card);
     lv_obj_align(sw_vibration, LV_ALIGN_TOP_RIGHT, -20, 55);
-    lv_obj_add_state(sw_vibration, LV_STATE_CHECKED); // Default ON
-    lv_obj_set_style_bg_color(sw_vibration, COLOR_CYAN, LV_PART_INDICATOR | LV_STATE_CHECKED);
+    if (vibration_on) lv_obj_add_state(sw_vibration, LV_STATE_CHECKED); // Default ON
+    lv_obj_add_style(sw_vibration, &style_accent_bg, LV_PART_INDICATOR | LV_STATE_CHECKED);
     lv_obj_add_event_cb(sw_vibration, toggle_vibration_cb, LV_EVENT_VALUE_CHANGED, NULL);
+
+    // Slouch angle (per user, pushed to the sender)
+    lv_obj_t * lbl_angle = lv_label_create(card);
+    lv_label_set_text(lbl_angle, "Slouch Angle");
+    lv_obj_add_style(lbl_angle, &style_label_white, 0);
+    lv_obj_align(lbl_angle, LV_ALIGN_TOP_LEFT, 20, 90);
+    lbl_angle_val = lv_label_create(card);
+    lv_label_set_text_fmt(lbl_angle_val, "%d\xC2\xB0", sender_cfg.enter_deg);
+    lv_obj_add_style(lbl_angle_val, &style_label_accent, 0);
+    lv_obj_align(lbl_angle_val, LV_ALIGN_TOP_RIGHT, -20, 90);
+    slider_angle = lv_slider_create(card);
+    lv_obj_set_size(slider_angle, 220, 8);
+    lv_obj_align(slider_angle, LV_ALIGN_TOP_MID, 0, 118);
+    lv_slider_set_range(slider_angle, 8, 30);
+    lv_slider_set_value(slider_angle, sender_cfg.enter_deg, LV_ANIM_OFF);
+    lv_obj_add_style(slider_angle, &style_accent_bg, LV_PART_INDICATOR);
+    lv_obj_add_style(slider_angle, &style_accent_bg, LV_PART_KNOB);
+    lv_obj_add_event_cb(slider_angle, slider_angle_cb, LV_EVENT_VALUE_CHANGED, NULL);
+    lv_obj_add_event_cb(slider_angle, slider_angle_cb, LV_EVENT_RELEASED, NULL);
+
+    // Telemetry policy: full stream, event-driven with heartbeat, or batched stream
+    lv_obj_t * lbl_tx = lv_label_create(card);
+    lv_label_set_text(lbl_tx, "Telemetry");
+    lv_obj_add_style(lbl_tx, &style_label_white, 0);
+    lv_obj_align(lbl_tx, LV_ALIGN_TOP_LEFT, 20, 150);
+    lv_obj_t * btn_tx = lv_btn_create(card);
+    lv_obj_set_size(btn_tx, 80, 30);
+    lv_obj_align(btn_tx, LV_ALIGN_TOP_RIGHT, -20, 143);
+    lv_obj_add_style(btn_tx, &style_btn_flat, 0);
+    lv_obj_add_event_cb(btn_tx, btn_tx_policy_cb, LV_EVENT_CLICKED, NULL);
+    lbl_tx_policy = lv_label_create(btn_tx);
+    tx_policy_label();
+    lv_obj_add_style(lbl_tx_policy, &style_label_accent, 0);
+    lv_obj_add_style(lbl_tx_policy, &style_font_12, 0);
+    lv_obj_center(lbl_tx_policy);
+
+    // Sender firmware, pushed from this box's "sndfw" partition
+    lv_obj_t * lbl_fw = lv_label_create(card);
+    lv_label_set_text(lbl_fw, "Sender Firmware");
+    lv_obj_add_style(lbl_fw, &style_label_white, 0);
+    lv_obj_align(lbl_fw, LV_ALIGN_TOP_LEFT, 20, 195);
+    btn_ota = lv_btn_create(card);
+    lv_obj_set_size(btn_ota, 80, 30);
+    lv_obj_align(btn_ota, LV_ALIGN_TOP_RIGHT, -20, 188);
+    lv_obj_add_style(btn_ota, &style_btn_flat, 0);
+    lv_obj_add_event_cb(btn_ota, btn_ota_cb, LV_EVENT_CLICKED, NULL);
+    lv_obj_t * lbl_btn = lv_label_create(btn_ota);
+    lv_label_set_text(lbl_btn, LV_SYMBOL_UPLOAD " UPDATE");
+    lv_obj_add_style(lbl_btn, &style_label_accent, 0);
+    lv_obj_add_style(lbl_btn, &style_font_12, 0);
+    lv_obj_center(lbl_btn);
+
+    lbl_ota = lv_label_create(card);
+    lv_obj_add_style(lbl_ota, &style_label_muted, 0);
+    add_status_styles(lbl_ota, STATE_OK | STATE_ALERT);
+    lv_obj_align(lbl_ota, LV_ALIGN_TOP_LEFT, 20, 220);
+    lv_label_set_text(lbl_ota, "Keep the wearable close");
+    ota_render(true);
+
+    // Research capture, logged over USB with Host_Tools/stream_decode.py
+    lv_obj_t * lbl_cap = lv_label_create(card);
+    lv_label_set_text(lbl_cap, "Research Capture");
+    lv_obj_add_style(lbl_cap, &style_label_white, 0);
+    lv_obj_align(lbl_cap, LV_ALIGN_TOP_LEFT, 20, 255);
+    lv_obj_t * btn_cap = lv_btn_create(card);
+    lv_obj_set_size(btn_cap, 80, 30);
+    lv_obj_align(btn_cap, LV_ALIGN_TOP_RIGHT, -20, 248);
+    lv_obj_add_style(btn_cap, &style_btn_flat, 0);
+    lv_obj_add_event_cb(btn_cap, btn_capture_cb, LV_EVENT_CLICKED, NULL);
+    lbl_capture = lv_label_create(btn_cap);
+    lv_label_set_text(lbl_capture, capture_label(capture_mode));
+    lv_obj_add_style(lbl_capture, &style_label_accent, 0);
+    lv_obj_add_style(lbl_capture, &style_font_12, 0);
+    lv_obj_center(lbl_capture);
+
+    // Backlight off after this long without a touch or the wearable
+    lv_obj_t * lbl_scr = lv_label_create(card);
+    lv_label_set_text(lbl_scr, "Screen Off");
+    lv_obj_add_style(lbl_scr, &style_label_white, 0);
+    lv_obj_align(lbl_scr, LV_ALIGN_TOP_LEFT, 20, 295);
+    lv_obj_t * btn_scr = lv_btn_create(card);
+    lv_obj_set_size(btn_scr, 80, 30);
+    lv_obj_align(btn_scr, LV_ALIGN_TOP_RIGHT, -20, 288);
+    lv_obj_add_style(btn_scr, &style_btn_flat, 0);
+    lv_obj_add_event_cb(btn_scr, btn_screen_off_cb, LV_EVENT_CLICKED, NULL);
+    lv_obj_t * lbl_scr_val = lv_label_create(btn_scr);
+    screen_off_label(lbl_scr_val);
+    lv_obj_add_style(lbl_scr_val, &style_label_accent, 0);
+    lv_obj_add_style(lbl_scr_val, &style_font_12, 0);
+    lv_obj_center(lbl_scr_val);
+}
+
+void build_diag_tab(void) {
+    panel_diag = create_tab_panel();
+
+    lv_obj_t * card = create_glass_card(panel_diag, 280, 165);
+    lv_obj_center(card);
+
+    lv_obj_t * title = lv_label_create(card);
+    lv_label_set_text(title, "MEMORY");
+    lv_obj_add_style(title, &style_label_muted, 0);
+    lv_obj_align(title, LV_ALIGN_TOP_LEFT, 10, 5);
+
+    label_diag = lv_label_create(card);
+    lv_obj_add_style(label_diag, &style_label_white, 0);
+    lv_obj_add_style(label_diag, &style_font_12, 0);
+    lv_obj_align(label_diag, LV_ALIGN_TOP_LEFT, 10, 25);
+
+    // Below the memory block; the card scrolls to reach it
+    lv_obj_add_flag(card, LV_OBJ_FLAG_SCROLLABLE);
+    label_prof = lv_label_create(card);
+    lv_obj_add_style(label_prof, &style_label_muted, 0);
+    lv_obj_align(label_prof, LV_ALIGN_TOP_LEFT, 10, 140);
+    lv_label_set_text(label_prof, PROFILE_ENABLED ? "" : "Profiler off (PROFILE_ENABLED)");
 }
 
 void build_nav_bar(void) {
     lv_obj_t * bot_bar = lv_obj_create(scr);
     lv_obj_set_size(bot_bar, 320, 50);
     lv_obj_align(bot_bar, LV_ALIGN_BOTTOM_MID, 0, 0);
-    lv_obj_set_style_bg_color(bot_bar, lv_color_hex(0x050A0F), 0);
-    lv_obj_set_style_border_side(bot_bar, LV_BORDER_SIDE_TOP, 0);
-    lv_obj_set_style_border_color(bot_bar, lv_color_hex(0x1A2633), 0);
+    lv_obj_add_style(bot_bar, &style_nav_bar, 0);
     lv_obj_clear_flag(bot_bar, LV_OBJ_FLAG_SCROLLABLE);
 
-    const char * icons[] = {LV_SYMBOL_HOME, LV_SYMBOL_LIST, LV_SYMBOL_SETTINGS};
-    for(int i=0; i<3; i++) {
+    const char * icons[] = {LV_SYMBOL_HOME, LV_SYMBOL_LIST, LV_SYMBOL_SETTINGS, LV_SYMBOL_EYE_OPEN};
+    for(int i=0; i<TAB_COUNT; i++) {
         nav_labels[i] = lv_label_create(bot_bar);
         lv_label_set_text(nav_labels[i], icons[i]);
-        lv_obj_set_style_text_font(nav_labels[i], &lv_font_montserrat_20, 0);
-        lv_obj_align(nav_labels[i], LV_ALIGN_CENTER, (i-1)*100, 0);
+        lv_obj_add_style(nav_labels[i], &style_font_20, 0);
+        lv_obj_add_style(nav_labels[i], &style_idle, 0);
+        lv_obj_add_style(nav_labels[i], &style_label_accent, LV_STATE_CHECKED);
+        lv_obj_align(nav_labels[i], LV_ALIGN_CENTER, (2*i - 3) * 40, 0);
         lv_obj_add_flag(nav_labels[i], LV_OBJ_FLAG_CLICKABLE);
         lv_obj_add_event_cb(nav_labels[i], nav_click_cb, LV_EVENT_CLICKED, (void*)(size_t)i);
     }
 }
 
-static void update_loop(lv_timer_t * timer) {
-    static int minute_counter = 0;
-    minute_counter++;
-    if (minute_counter >= 2000) { 
-        minute_counter = 0;
-        lv_chart_set_next_value(chart_posture, ser_posture, (int)fabs(current_pitch));
+// ======================= SCREEN MANAGER =======================
+// Only the home tab exists at boot. The others are built the first time
+// they are opened and deleted again once they have stayed hidden for
+// TAB_FREE_MS; their state lives in sender_cfg and the flags above, and the
+// chart is redrawn from the radio core's export.
+#define TAB_FREE_MS  60000
+
+typedef struct {
+    lv_obj_t ** panel;
+    void (*build)(void);
+    void (*on_enter)(void);     // After the panel is shown, optional
+    void (*on_free)(void);      // After the panel is deleted, optional
+    bool lazy;                  // Freed after TAB_FREE_MS hidden
+    lv_timer_t * free_timer;
+} tab_t;
+
+static void stats_enter(void) {
+    refresh_chart();
+    render_summary();
+}
+
+static void stats_free(void) {
+    chart_posture = NULL;
+    label_chart_title = NULL;
+    strip_free();
+    label_summary = NULL;
+}
+
+static void settings_free(void) {
+    btn_ota = NULL;
+    lbl_ota = NULL;
+    lbl_capture = NULL;
+}
+
+static void diag_free(void) {
+    label_diag = NULL;
+    label_prof = NULL;
+}
+
+static tab_t tabs[TAB_COUNT] = {
+    { &panel_home,     build_home_tab,     NULL,        NULL,       false, NULL },
+    { &panel_stats,    build_stats_tab,    stats_enter, stats_free, true,  NULL },
+    { &panel_settings, build_settings_tab, NULL,        settings_free, true, NULL },
+    { &panel_diag,     build_diag_tab,     diag_render, diag_free,  true,  NULL },
+};
+
+static void tab_free_cb(lv_timer_t * t) {
+    tab_t * tab = t->user_data;
+    tab->free_timer = NULL;     // One-shot, LVGL deletes it after this run
+    lv_obj_del(*tab->panel);
+    *tab->panel = NULL;
+    if (tab->on_free) tab->on_free();
+}
+
+static void tab_enter(int i) {
+    tab_t * tab = &tabs[i];
+    if (tab->free_timer) {
+        lv_timer_del(tab->free_timer);
+        tab->free_timer = NULL;
+    }
+    if (!*tab->panel) tab->build();
+
+    lv_obj_clear_flag(*tab->panel, LV_OBJ_FLAG_HIDDEN);
+    lv_anim_t a;
+    lv_anim_init(&a);
+    lv_anim_set_var(&a, *tab->panel);
+    lv_anim_set_values(&a, LV_OPA_TRANSP, LV_OPA_COVER);
+    lv_anim_set_time(&a, 300);
+    lv_anim_set_exec_cb(&a, opa_anim_cb); 
+    lv_anim_start(&a);
+    lv_obj_add_state(nav_labels[i], LV_STATE_CHECKED);
+    if (tab->on_enter) tab->on_enter();
+}
+
+static void tab_leave(int i) {
+    tab_t * tab = &tabs[i];
+    lv_obj_clear_state(nav_labels[i], LV_STATE_CHECKED);
+    if (!*tab->panel || lv_obj_has_flag(*tab->panel, LV_OBJ_FLAG_HIDDEN)) return;
+
+    lv_anim_del(*tab->panel, opa_anim_cb);
+    lv_obj_add_flag(*tab->panel, LV_OBJ_FLAG_HIDDEN);
+    if (tab->lazy && !tab->free_timer) {
+        tab->free_timer = lv_timer_create(tab_free_cb, TAB_FREE_MS, tab);
+        lv_timer_set_repeat_count(tab->free_timer, 1);
     }
+}
 
-    water_timer_ticks++;
-    if (water_timer_ticks > WATER_REMINDER_THRESHOLD) {
+static void switch_tab(int tab_id) {
+    for(int i=0; i<TAB_COUNT; i++) {
+        if (i != tab_id) tab_leave(i);
+    }
+    tab_enter(tab_id);
+}
+
+// UI core: render whatever the radio core last published. Every widget
+// write is skipped unless its value changed.
+static void update_loop(lv_timer_t * timer) {
+    PROF_SCOPE(PROF_UI_LOOP);
+    int64_t remaining = water_due_ms - esp_timer_get_time() / 1000;
+    if (remaining <= 0) {
         water_alert_active = true;
+        remaining = 0;
     }
 
-    int remaining = WATER_REMINDER_THRESHOLD - water_timer_ticks;
-    if (remaining < 0) remaining = 0;
-    
-    int total_seconds = remaining * 0.03; 
+    int total_seconds = (remaining + 999) / 1000;
     int mins = total_seconds / 60;
     int secs = total_seconds % 60;
-    lv_label_set_text_fmt(label_water_timer, "%02d:%02d", mins, secs);
+    static int shown_seconds = -1;
+    if (total_seconds != shown_seconds) {
+        shown_seconds = total_seconds;
+        lv_label_set_text_fmt(label_water_timer, "%02d:%02d", mins, secs);
+    }
+
+    if (bench.running) return;     // The benchmark owns the dot and the tabs
+
+    if (panel_stats && !lv_obj_has_flag(panel_stats, LV_OBJ_FLAG_HIDDEN)
+        && atomic_load_explicit(&chart_lock.seq, memory_order_relaxed) != chart_shown_seq) {
+        refresh_chart();
+    }
+    if (panel_stats && !lv_obj_has_flag(panel_stats, LV_OBJ_FLAG_HIDDEN)
+        && atomic_load_explicit(&analytics_lock.seq, memory_order_relaxed) != summary_shown_seq) {
+        render_summary();
+    }
+
+    ota_render(false);
 
-    posture_packet_t packet;
-    if (xQueueReceive(posture_queue, &packet, 0) == pdTRUE) {
-        last_packet_tick = xTaskGetTickCount();
-        lv_obj_set_style_text_color(label_wifi_icon, COLOR_GREEN, 0);
+    ui_snapshot_t snap;
+    snapshot_read(&snap);
+    static bool shown_linked = false;
+    static int shown_dot_y = 0, shown_pitch = INT32_MIN;
 
-        float p = packet.pitch;
-        current_pitch = p;
+    if (snap.linked) {
+        if (!shown_linked) set_status(label_wifi_icon, STATE_OK);
+        update_battery_ui(snap.battery_pct);
 
-        float raw_y = p * 1.5f; 
+        float raw_y = snap.pitch * 1.5f; 
         if (raw_y > 45.0f) raw_y = 45.0f;
         if (raw_y < -45.0f) raw_y = -45.0f;
+        if ((int)raw_y != shown_dot_y || !shown_linked) {
+            shown_dot_y = (int)raw_y;
+            lv_obj_align_to(posture_dot, spine_track, LV_ALIGN_CENTER, 0, shown_dot_y);
+        }
+        if ((int)lroundf(snap.pitch) != shown_pitch) {
+            shown_pitch = (int)lroundf(snap.pitch);
+            lv_label_set_text_fmt(label_pitch_val, "P: %d", shown_pitch);
+        }
 
-        lv_obj_align_to(posture_dot, spine_track, LV_ALIGN_CENTER, 0, (int)raw_y);
-        lv_label_set_text_fmt(label_pitch_val, "P: %.0f", p);
+        if (snap.state != shown_state) render_posture_state(snap.state);
 
         // --- PRIORITY HEADER: Water Alert > Slouch Alert > Good ---
-        if (water_alert_active) {
-            lv_label_set_text(label_posture_status, "DRINK WATER!");
-            // Use Orange for high visibility alert
-            lv_obj_set_style_text_color(label_posture_status, COLOR_ORANGE, 0);
-        }
-        else if (fabs(p) > 15.0f) {
-            lv_obj_set_style_bg_color(posture_dot, COLOR_RED, 0);
-            lv_obj_set_style_shadow_color(posture_dot, COLOR_RED, 0);
-            
-            lv_label_set_text(label_posture_status, "SLOUCH DETECTED");
-            lv_obj_set_style_text_color(label_posture_status, COLOR_RED, 0);
-        } else {
-            lv_obj_set_style_bg_color(posture_dot, COLOR_CYAN, 0);
-            lv_obj_set_style_shadow_color(posture_dot, COLOR_CYAN, 0);
-            
-            lv_label_set_text(label_posture_status, "POSTURE GOOD");
-            lv_obj_set_style_text_color(label_posture_status, COLOR_GREEN, 0);
-        }
+        if (water_alert_active) set_header(HEADER_WATER);
+        else if (shown_state == POSTURE_SLOUCH) set_header(HEADER_SLOUCH);
+        else set_header(HEADER_GOOD);
     } 
-    else {
+    else if (snap.searching && shown_header != HEADER_SEARCHING) {
         // Disconnected State
-        if ((xTaskGetTickCount() - last_packet_tick) > pdMS_TO_TICKS(CONNECTION_TIMEOUT_MS)) {
-            lv_obj_set_style_text_color(label_wifi_icon, COLOR_TEXT_GRAY, 0); 
-            lv_label_set_text(label_posture_status, "SEARCHING...");
-            lv_obj_set_style_text_color(label_posture_status, COLOR_TEXT_GRAY, 0);
-            
-            lv_obj_align_to(posture_dot, spine_track, LV_ALIGN_CENTER, 0, 0);
-        }
+        set_status(label_wifi_icon, 0);
+        set_header(HEADER_SEARCHING);
+        
+        shown_dot_y = 0;
+        lv_obj_align_to(posture_dot, spine_track, LV_ALIGN_CENTER, 0, 0);
     }
+    shown_linked = snap.linked;
 }
 
-void app_main(void) {
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
+// ======================= DISPLAY POWER =======================
+// UI core. Touches and frames from the sender count as activity. Once the
+// backlight is off, the UI loop and LVGL's refresh timer are paused; only
+// LVGL's touch read and this poll still run. The top layer is made
+// clickable while dark, so a touch there only wakes the screen and never
+// reaches the button under the finger.
+typedef enum { DISP_ON, DISP_DIM, DISP_OFF } disp_power_t;
+
+static const char * DISP_POWER_NAMES[] = { "on", "dimmed", "off" };
+static disp_power_t disp_power = DISP_ON;
+static lv_timer_t * update_timer;
+
+static void display_set_power(disp_power_t p) {
+    if (p == disp_power) return;
+    lv_disp_t * disp = lv_disp_get_default();
+    if (disp_power == DISP_OFF) {
+        lv_obj_clear_flag(lv_layer_top(), LV_OBJ_FLAG_CLICKABLE);
+        lv_timer_resume(disp->refr_timer);
+        lv_timer_resume(update_timer);
+        lv_timer_ready(update_timer);           // Catch up before the first frame goes out
+        lv_obj_invalidate(lv_scr_act());
     }
-    ESP_ERROR_CHECK(ret);
+    switch (p) {
+        case DISP_ON:
+            bsp_display_brightness_set(DISPLAY_BRIGHT_PCT);
+            break;
+        case DISP_DIM:
+            bsp_display_brightness_set(DISPLAY_DIM_PCT);
+            break;
+        case DISP_OFF:
+            bsp_display_backlight_off();
+            lv_timer_pause(update_timer);
+            lv_timer_pause(disp->refr_timer);
+            lv_obj_add_flag(lv_layer_top(), LV_OBJ_FLAG_CLICKABLE);
+            break;
+    }
+    ESP_LOGI("DISPLAY", "Screen %s", DISP_POWER_NAMES[p]);
+    disp_power = p;
+}
 
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    
-    wifi_init_offline(); 
-    init_esp_now();      
+static void display_wake_cb(lv_event_t * e) {
+    display_set_power(DISP_ON);
+}
+
+static void display_power_cb(lv_timer_t * t) {
+    static uint32_t seen_frames;
+    ui_snapshot_t snap;
+    snapshot_read(&snap);
+    bool due = !water_alert_active && esp_timer_get_time() / 1000 >= water_due_ms;
+    if (snap.frames != seen_frames || due || bench.running) {
+        seen_frames = snap.frames;
+        lv_disp_trig_activity(NULL);
+    }
+
+    uint32_t idle_ms = lv_disp_get_inactive_time(NULL);
+    disp_power_t want = DISP_ON;
+    if (screen_off_min && idle_ms >= screen_off_min * 60000u) want = DISP_OFF;
+    else if (idle_ms >= DISPLAY_DIM_S * 1000u) want = DISP_DIM;
+    display_set_power(want);
+}
 
-    bsp_display_start();
+// UI core: display bring-up and the first screen, in parallel with the
+// radio bring-up that app_main does on the radio core.
+static void ui_init_task(void * arg) {
+    int64_t t = esp_timer_get_time();
+
+    // LVGL task on the UI core; the radio core keeps Wi-Fi and ingest_task
+    bsp_display_cfg_t disp_cfg = {
+        .lvgl_port_cfg = ESP_LVGL_PORT_INIT_CONFIG(),
+        .buffer_size = BSP_LCD_H_RES * DISPLAY_BUF_LINES,
+        .double_buffer = DISPLAY_DOUBLE_BUF,
+        .flags = {
+            .buff_dma = !DISPLAY_BUF_PSRAM,
+            .buff_spiram = DISPLAY_BUF_PSRAM,
+        },
+    };
+    disp_cfg.lvgl_port_cfg.task_affinity = UI_CORE;
+    lv_disp_t * disp = bsp_display_start_with_config(&disp_cfg);
     bsp_display_backlight_on();
     bsp_display_lock(0);
+    disp->driver->monitor_cb = disp_monitor_cb;
+    t = boot_phase("display", t);
     
     scr = lv_scr_act();
     lv_obj_set_style_bg_color(scr, COLOR_BG, 0);
+    theme_init();
 
     label_posture_status = lv_label_create(scr);
     lv_label_set_text(label_posture_status, "WAITING...");
-    lv_obj_set_style_text_font(label_posture_status, &lv_font_montserrat_14, 0);
-    lv_obj_set_style_text_color(label_posture_status, lv_color_white(), 0);
+    lv_obj_add_style(label_posture_status, &style_label_white, 0);
+    lv_obj_add_style(label_posture_status, &style_font_14, 0);
+    add_status_styles(label_posture_status, STATE_STATUS);
     lv_obj_align(label_posture_status, LV_ALIGN_TOP_LEFT, 15, 10);
+    lv_obj_add_flag(label_posture_status, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(label_posture_status, header_long_press_cb, LV_EVENT_LONG_PRESSED, NULL);
 
     label_wifi_icon = lv_label_create(scr);
     lv_label_set_text(label_wifi_icon, LV_SYMBOL_WIFI);
-    lv_obj_set_style_text_font(label_wifi_icon, &lv_font_montserrat_14, 0);
-    lv_obj_set_style_text_color(label_wifi_icon, COLOR_TEXT_GRAY, 0);
+    lv_obj_add_style(label_wifi_icon, &style_idle, 0);
+    lv_obj_add_style(label_wifi_icon, &style_font_14, 0);
+    add_status_styles(label_wifi_icon, STATE_OK);
     lv_obj_align(label_wifi_icon, LV_ALIGN_TOP_RIGHT, -15, 10);
 
-    build_home_tab();
-    build_stats_tab();
-    build_settings_tab();
-    
-    build_nav_bar();
-    switch_tab(0);
+    label_battery = lv_label_create(scr);
+    lv_label_set_text(label_battery, "");
+    lv_obj_add_style(label_battery, &style_label_muted, 0);
+    add_status_styles(label_battery, STATE_ALERT);
+    lv_obj_align(label_battery, LV_ALIGN_TOP_RIGHT, -40, 12);
 
-    lv_timer_create(update_loop, 30, NULL);
+    build_nav_bar();
+    switch_tab(0);      // Builds the home tab; the others wait for first use
+
+    water_due_ms = esp_timer_get_time() / 1000 + WATER_REMINDER_MS;
+    update_timer = lv_timer_create(update_loop, UI_LOOP_MS, NULL);
+    lv_obj_add_event_cb(lv_layer_top(), display_wake_cb, LV_EVENT_PRESSED, NULL);
+    lv_timer_create(display_power_cb, DISPLAY_POLL_MS, NULL);
+    lv_timer_create(diag_sample_cb, DIAG_SAMPLE_MS, NULL);
+    diag_sample_cb(NULL);       // Baseline, logged right away
     
     bsp_display_unlock();
+    boot_phase("ui built", t);
+    vTaskDelete(NULL);
+}
+
+void app_main(void) {
+    int64_t boot_us = boot_phase("app_main", 0);
+    int64_t t = boot_us;
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+    load_sender_settings();     // The settings tab reads sender_cfg
+    load_display_settings();
+    t = boot_phase("nvs", t);
+
+    // Display on the UI core, radio here on the radio core (app_main's core).
+    // The queue exists first so UI callbacks can post commands at any time.
+    cmd_queue = xQueueCreate(8, sizeof(command_packet_t));
+    xTaskCreatePinnedToCore(ui_init_task, "ui_init", 6144, NULL, 5, NULL, UI_CORE);
+
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    
+    wifi_init_offline(); 
+    init_esp_now();      
+    boot_phase("radio", t);
 }
\ No newline at end of file
@@ -1,18 +1,42 @@
 /*
  * OFF-GRID Posture Sender (ESP32-C3 SuperMini)
  * Fix: Sends "Keep-Alive" packets during calibration to prevent disconnects.
+ * Slouch detection (hysteresis, dwell, alert cooldown) runs here; the receiver
+ * only renders the state and events it is sent. Sensing continues while the
+ * motor runs: the angle rides on the gyro until the vibration has settled.
+ * Between readings it light-sleeps; left unworn it deep-sleeps until moved.
  */
 #include <stdio.h>
 #include <math.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <sys/time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "driver/gpio.h"
 #include "driver/i2c.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
 #include "esp_now.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_crc.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "esp_random.h"
+#include "esp_attr.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "mbedtls/sha256.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 
 // --- CONFIGURATION ---
 #define ESP_NOW_CHANNEL    1 
@@ -24,31 +48,621 @@ uint8_t BROADCAST_MAC[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 #define LED_PIN            8
 #define BUTTON_PIN         9 
 #define VIB_MOTOR_PIN      3   
+#define MPU_INT_PIN        4       // MPU6050 INT; must be GPIO 0-5 to wake from deep sleep
+#define BATTERY_ADC_CHAN   ADC_CHANNEL_0   // GPIO 0, battery (+) via 100k/100k divider
 
-#define BAD_POSTURE_ANGLE  15.0f 
+// --- DETECTION DEFAULTS (overridden by the receiver) ---
+#define DET_ENTER_DEG      15.0f   // |pitch| above this starts a slouch
+#define DET_EXIT_DEG       12.0f   // |pitch| below this ends it
+#define DET_DWELL_MS       1000    // Condition must hold this long to switch
+#define DET_COOLDOWN_MS    10000   // Minimum gap between haptic alerts
+// Accepted from the receiver; exit must also sit at least 1 deg below enter
+#define DET_ENTER_MIN_DEG  5
+#define DET_ENTER_MAX_DEG  60
+#define DET_DWELL_MIN_MS   100     // Shorter lets sensor noise flip the state
+#define DET_DWELL_MAX_MS   10000
+#define DET_COOLDOWN_MIN_MS 1000
+#define DET_COOLDOWN_MAX_MS 120000
+
+// --- SLOUCH FORECAST ---
+// A short nudge when pitch is heading for the enter threshold, before the
+// full alert. Set FORECAST_ENABLED to 0 for threshold-only alerts.
+#define FORECAST_ENABLED   1
+#define FORECAST_WINDOW_MS 3000    // Trend fitted over this much history
+#define FORECAST_POINTS    32      // Ring size; covers the window at the sitting rate
+#define FORECAST_MIN_PTS   10
+#define FORECAST_LEAD_DEG  8.0f    // Only this close below the enter threshold
+#define FORECAST_MIN_DPS   0.5f    // Slower drift is noise or a deliberate lean
+#define FORECAST_HORIZON_MS 4000   // Nudge when the crossing is due within this
+#define HAPTIC_NUDGE_MS    60      // Gentler than HAPTIC_PULSE_MS
+
+// --- HAPTICS / ORIENTATION ---
+#define HAPTIC_PULSE_MS    200
+#define HAPTIC_SETTLE_MS   50      // Motor spin-down still shakes the accelerometer
+#define FUSION_GYRO_SHARE  0.96f   // Complementary filter weight on the gyro path
+#define FUSION_ACC_TOL_G2  0.15f   // Trust the accelerometer only this close to 1 g (squared)
+#define GYRO_LSB_PER_DPS   131.0f  // +-250 dps range
+#define GYRO_STILL_DPS     3.0f    // Below this, outside haptics, let the bias estimate follow
+
+// --- ACTIVITY ---
+// Thresholds on window features (see ACTIVITY CLASSIFIER); tuned by eye
+// against typical trunk motion, not a trained model.
+#define ACT_WINDOW         16      // Samples per feature window
+#define ACT_MOVE_VAR       4000    // |a| variance, mg^2 (~63 mg rms)
+#define ACT_MOVE_GYRO      2500    // Mean gyro energy, (0.1 dps)^2 (~5 dps rms)
+#define ACT_MOVE_JERK      2500    // Mean squared sample-to-sample change, mg^2 (~50 mg)
+#define ACT_SWAY_VAR       150     // |a| variance above this while still: standing sway
+#define ACT_HOLD           5       // Samples a calmer class must persist before switching
+
+// --- BATTERY ---
+#define BATTERY_DIVIDER    2       // 100k/100k divider halves the cell voltage
+#define BATTERY_SAMPLE_MS  10000   // LiPo voltage moves slowly, sample rarely
+#define BATTERY_READS      4       // Oneshot reads averaged per sample
+#define BATTERY_UNKNOWN    0xFF    // Sent until the first valid sample
+
+// --- TELEMETRY ---
+#define TX_POLICY_STREAM   0       // Sample every loop
+#define TX_POLICY_EVENT    1       // Sample on state change or delta, else heartbeat only
+#define TX_POLICY_BATCH    2       // Every loop's sample, delta-coded into PKT_BATCH frames
+#define BATCH_FLUSH_MS     2000    // Longest a sample waits in an open batch
+#define BATCH_MAX_DT_MS    16383   // Longer gaps start a new batch (dt fits a 2-byte varint)
+#define TX_DELTA_DEG       2.0f    // Default pitch/roll change that forces a sample
+#define HEARTBEAT_MS       5000
+
+// --- POWER ---
+#define POWER_SAVE         1       // 0: CPU and radio stay fully on, for comparing modes
+#define RADIO_LISTEN_MS    50      // Radio held up after each transmission for the reply
+#define RADIO_WAKE_EVERY_MS 1000   // In modem sleep ESP-NOW also listens this often...
+#define RADIO_WAKE_WINDOW_MS 20    // ...for this long
+#define NOT_WORN_MS        300000  // Held this still this long: deep sleep until moved, 0 = never
+#define NOT_WORN_DEG       1.0f    // Breathing alone moves a worn sensor more than this
+#define MPU_MOTION_THR     20      // Wake-on-motion threshold, ~2 mg/LSB after the high-pass
+#define ENERGY_LOG_MS      60000
+#define BATTERY_MAH        400     // Cell size for the battery life estimate
+
+// Typical currents for the charge estimate (datasheet figures, not measured), mA
+#define I_CPU_MA           22.0f   // C3 running at 160 MHz
+#define I_LIGHT_MA         0.13f   // C3 in light sleep
+#define I_RADIO_MA         85.0f   // Radio up; transmit bursts are short and folded in
+#define I_SENSOR_MA        3.9f    // MPU6050, accelerometer and gyro
+#define I_MOTOR_MA         70.0f
+#define I_DEEP_MA          0.03f   // C3 deep sleep plus the MPU in 5 Hz wake-on-motion
+
+// --- TIME SYNC ---
+#define TSYNC_PERIOD_MS    60000   // One exchange a minute once locked...
+#define TSYNC_FAST_MS      2000    // ...every 2 s until TSYNC_LOCK offsets are in
+#define TSYNC_POINTS       8       // Offsets kept for the drift fit
+#define TSYNC_LOCK         4
+#define TSYNC_MAX_RTT_US   20000   // Slower exchanges are too uncertain to use
+#define TSYNC_RESET_US     50000   // Further off the fit: the receiver restarted, start over
+#define TSYNC_MAX_PPM      200     // A fitted drift beyond this is noise, not a crystal
+
+// --- STORE AND FORWARD ---
+#define LINK_LOSS_MS       (2 * HEARTBEAT_MS + 1000)   // Two unacked heartbeats
+#define BACKLOG_PERIOD_MS  5000    // One aggregate record per period
+#define BACKLOG_CAP        4320    // 6 h of records in RAM
+#define BACKLOG_PER_FRAME  22      // Records per frame, within FRAME_MAX
+#define BACKLOG_RETRIES    5
+#define BACKLOG_ACK_MS     100
+
+// --- OTA (image relayed by the receiver) ---
+#define OTA_CHUNK          192     // Image bytes per frame, 16-byte aligned for flash encryption
+#define OTA_WINDOW         32      // Chunks past the base the receiver may have in flight
+#define OTA_ACK_EVERY      8       // Chunks between status frames
+#define OTA_SAVE_EVERY     64      // Chunks between resume points saved to NVS
+#define OTA_IDLE_MS        3000    // Receiver quiet this long: pause, keep the resume point
+#define OTA_SECTOR         4096
+
+// --- RESEARCH CAPTURE (selected from the receiver) ---
+#define CAPTURE_ODR_HZ     1000    // Default MPU sample rate; 1 kHz max with the DLPF on
+#define CAPTURE_DECIM      10      // Default CIC decimation in filtered mode
+#define CAPTURE_DECIM_MAX  16      // Keeps the CIC gain (R^3) inside int32
+#define CAPTURE_POLL_MS    10      // FIFO drain period; 1024 B holds 85 ms at 1 kHz
+#define CAPTURE_BENCH_MS   10000   // Filter cost logged this often
+
+// --- PROFILER ---
+#define PROFILE_ENABLED    0       // 1: time hot paths and dump stats over serial
+#define PROFILE_DUMP_MS    30000
+#define PROF_MAX_TASKS     12
+
+// --- BOOT ---
+#define SENSOR_READY_MS    1000    // Give up waiting for the first valid MPU reading
 
 // --- PACKETS ---
-typedef struct {
+// Sender -> receiver frames start with a type byte and go out broadcast
+// (OTA status aside); receiver commands come addressed to us. A receiver
+// relaying a frame for another wraps it in a 16-byte header, so frames that
+// should be relayable stay within FRAME_MAX. On air every frame also ends
+// in a 2-byte sequence number (see frame_send), which the header carries.
+#define FRAME_MAX          (ESP_NOW_MAX_DATA_LEN - 16)
+#define PKT_SAMPLE         0x01
+#define PKT_EVENT          0x02
+#define PKT_HEARTBEAT      0x03
+#define PKT_BACKLOG        0x04
+#define PKT_OTA_STATUS     0x05
+#define PKT_CAPTURE        0x06
+#define PKT_BATCH          0x08
+#define PKT_TIME_REQ       0x40    // Clear of CMD_*: both are 2 bytes
+
+// PKT_BATCH, byte stream rather than a struct:
+//   type, flags (BATCH_HAS_*), count, state
+//   battery_pct            if BATCH_HAS_BATTERY (changed since the last batch)
+//   activity               if BATCH_HAS_ACTIVITY (likewise)
+//   t_ms, uint32 LE        if BATCH_HAS_TIME: shared clock of the first sample
+//   pitch, roll            int16 LE, 0.1 deg: the keyframe
+//   per further sample:    varint dt_ms, zigzag varint d_pitch, zigzag varint d_roll
+// Deltas are between quantised values, so error never builds up along a batch.
+#define BATCH_HAS_BATTERY  0x01
+#define BATCH_HAS_ACTIVITY 0x02
+#define BATCH_HAS_TIME     0x04
+#define BATCH_SAMPLE_MAX   8       // Worst case: 2-byte dt, two 3-byte deltas
+
+typedef enum {
+    POSTURE_GOOD = 0,
+    POSTURE_SLOUCH = 1,
+} posture_state_t;
+
+// Packed so the small fields don't drag padding into every sample.
+typedef struct __attribute__((packed)) {
+    uint8_t type;          // PKT_SAMPLE
+    uint8_t state;         // posture_state_t, lets the receiver resync after a lost event
     float pitch;
     float roll;
-    int battery_level;
+    uint32_t t_ms;         // Reading time on the shared clock (TIME SYNC), 0 until synced
 } posture_packet_t;
 
+// Sent every HEARTBEAT_MS in both policies; slow-moving fields ride here.
+typedef struct __attribute__((packed)) {
+    uint8_t type;          // PKT_HEARTBEAT
+    uint8_t state;
+    uint8_t battery_pct;   // 0-100, BATTERY_UNKNOWN if not measured
+    uint8_t hb_interval_ds;// Longest silence to expect, 100 ms units; 0 while streaming
+    float pitch;
+    float roll;
+    uint8_t activity;      // activity_t
+    uint32_t t_ms;         // Shared clock, as in posture_packet_t
+} heartbeat_packet_t;
+
+// Sent once per detector transition.
+typedef struct __attribute__((packed)) {
+    uint8_t type;          // PKT_EVENT
+    uint8_t state;         // New posture_state_t
+    uint8_t seq;           // Increments per transition
+    float pitch;           // Pitch that completed the transition
+    uint32_t t_ms;         // Shared clock, as in posture_packet_t
+} posture_event_t;
+
+// Aggregate of BACKLOG_PERIOD_MS of samples, kept while the receiver is away
+typedef struct __attribute__((packed)) {
+    uint32_t t_ms;         // Sender uptime at the end of the period
+    int16_t pitch_dd;      // Mean pitch, 0.1 deg
+    int16_t roll_dd;       // Mean roll, 0.1 deg
+    uint8_t max_pitch;     // Peak |pitch|, whole degrees
+    uint8_t slouch_frac;   // Share of the period spent slouching, 0-255
+} backlog_rec_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;          // PKT_BACKLOG
+    uint8_t count;
+    uint16_t seq;          // Echoed in the receiver's CMD_BACKLOG_ACK
+    uint32_t now_ms;       // Sender uptime at send, to rebase t_ms
+    backlog_rec_t rec[BACKLOG_PER_FRAME];
+} backlog_frame_t;
+
+// Research capture: batches of full-rate raw samples or decimated
+// orientation. sample counts from the start of the capture at rate_hz, so
+// the host gets exact timing and sees lost frames as gaps.
+#define CAPTURE_OFF        0
+#define CAPTURE_RAW        1       // data: ax, ay, az, gx, gy, gz per sample, raw counts
+#define CAPTURE_FILTERED   2       // data: pitch, roll per sample, 0.01 deg
+#define CAPTURE_WORDS      118
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;          // PKT_CAPTURE
+    uint8_t mode;          // CAPTURE_RAW or CAPTURE_FILTERED
+    uint8_t count;         // Samples in data
+    uint16_t rate_hz;
+    uint32_t sample;       // Index of the first sample
+    int16_t data[CAPTURE_WORDS];
+} capture_frame_t;
+
+// Receiver -> sender commands
+#define CMD_CALIBRATE      1
+#define CMD_VIBRATION      2   // value: 0/1
+#define CMD_SET_ENTER_DEG  3   // value: degrees
+#define CMD_SET_EXIT_DEG   4   // value: degrees
+#define CMD_SET_DWELL      5   // value: 100 ms units
+#define CMD_SET_COOLDOWN   6   // value: seconds
+#define CMD_SET_TX_POLICY  7   // value: TX_POLICY_*
+#define CMD_SET_TX_DELTA   8   // value: 0.1 deg units
+#define CMD_HEARTBEAT_ACK  9
+#define CMD_BACKLOG_ACK    10  // backlog_ack_t
+#define CMD_OTA_BEGIN      11  // ota_begin_t
+#define CMD_OTA_DATA       12  // ota_chunk_t
+#define CMD_OTA_END        13  // Verify, switch partitions, reboot
+#define CMD_OTA_ABORT      14
+#define CMD_CAPTURE        15  // value: CAPTURE_*
+#define CMD_CAPTURE_ODR    16  // value: MPU sample rate, 10 Hz units
+#define CMD_CAPTURE_DECIM  17  // value: decimation factor in filtered mode
+#define CMD_TIME_SYNC      18  // time_sync_t, answers PKT_TIME_REQ
+
 typedef struct {
     uint8_t command_id; 
     uint8_t value;      
 } command_packet_t;
 
+// Sender -> receiver; the receiver stamps its arrival
+typedef struct __attribute__((packed)) {
+    uint8_t type;          // PKT_TIME_REQ
+    uint8_t seq;
+} time_req_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t command_id;    // CMD_TIME_SYNC
+    uint8_t seq;           // From the request
+    int64_t rx_us;         // Receiver uptime when the request arrived
+    uint32_t hold_us;      // Arrival to reply on the receiver
+} time_sync_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t command_id;    // CMD_BACKLOG_ACK
+    uint8_t value;         // Unused
+    uint16_t seq;
+} backlog_ack_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t command_id;    // CMD_OTA_BEGIN
+    uint8_t value;         // Unused
+    uint32_t size;         // Image bytes
+    uint8_t sha256[32];    // Over the whole image, checked before switching
+} ota_begin_t;
+
+// Sent with only len bytes of data
+typedef struct __attribute__((packed)) {
+    uint8_t command_id;    // CMD_OTA_DATA
+    uint8_t len;
+    uint16_t index;        // Chunk number, byte offset = index * OTA_CHUNK
+    uint32_t crc;          // esp_crc32_le over data
+    uint8_t data[OTA_CHUNK];
+} ota_chunk_t;
+
+#define OTA_ST_IDLE        0
+#define OTA_ST_RECEIVING   1
+#define OTA_ST_DONE        2       // Verified, rebooting into the new image
+#define OTA_ST_ERROR       3
+
+// Sender -> receiver: cumulative ack plus a selective ack of the window
+typedef struct __attribute__((packed)) {
+    uint8_t type;          // PKT_OTA_STATUS
+    uint8_t status;        // OTA_ST_*
+    uint16_t base;         // Every chunk below this is written
+    uint32_t sack;         // Bit i: chunk base + 1 + i written
+} ota_status_t;
+
 static const char *TAG = "SENDER";
 static float offset_pitch = 0;
 static float offset_roll = 0;
 static bool trigger_calibration = false;
 static bool vibration_enabled = true; 
+static uint8_t tx_policy = TX_POLICY_EVENT;
+static float tx_delta_deg = TX_DELTA_DEG;
+
+// --- BOOT PROFILE ---
+// Logs how long a boot phase took and when it ended, both from esp_timer,
+// which starts counting just before app_main.
+static int64_t boot_phase(const char *name, int64_t since_us) {
+    int64_t now = esp_timer_get_time();
+    ESP_LOGI("BOOT", "%-14s +%4ld ms  (t=%ld ms)", name, (long)((now - since_us) / 1000), (long)(now / 1000));
+    return now;
+}
+
+// --- PROFILER ---
+// The receiver's profiler (PROFILER in esp32-s3-box-3.c, documented there)
+// with this firmware's slots and a serial dump only.
+typedef enum {
+    PROF_MPU_READ,
+    PROF_DETECT,
+    PROF_TRANSMIT,         // Includes esp_now_send
+    PROF_BACKLOG,
+    PROF_LOOP,             // Loop body up to the feedback delay
+    PROF_CAPTURE,          // One FIFO drain: read, filter, send
+    PROF_SLOTS
+} prof_slot_t;
+
+#if PROFILE_ENABLED
+static const char *PROF_NAMES[PROF_SLOTS] = { "mpu_read", "detect", "transmit", "backlog", "loop", "capture" };
+
+#define PROF_BUCKETS       40      // Two per octave, 1 us up to ~1 s
+#define PROF_CPU_MHZ       CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t hist[PROF_BUCKETS];
+} prof_stat_t;
+
+static prof_stat_t prof[PROF_SLOTS];
+
+static int prof_bucket(uint32_t us) {
+    if (us < 2) return us;
+    int msb = 31 - __builtin_clz(us);
+    int b = msb * 2 + ((us >> (msb - 1)) & 1);
+    return b < PROF_BUCKETS ? b : PROF_BUCKETS - 1;
+}
+
+static uint32_t prof_bucket_top(int b) {
+    b++;
+    if (b < 2) return b;
+    int msb = b / 2;
+    return (1u << msb) + (b & 1) * (1u << (msb - 1));
+}
+
+static void prof_record(int slot, uint32_t us) {
+    prof_stat_t *p = &prof[slot];
+    if (p->count == 0 || us < p->min_us) p->min_us = us;
+    if (us > p->max_us) p->max_us = us;
+    p->count++;
+    p->total_us += us;
+    p->hist[prof_bucket(us)]++;
+}
+
+static uint32_t prof_percentile(const prof_stat_t *p, uint32_t pct) {
+    uint32_t want = ((uint64_t)p->count * pct + 99) / 100, seen = 0;
+    for (int b = 0; b < PROF_BUCKETS; b++) {
+        seen += p->hist[b];
+        if (seen >= want) {
+            uint32_t top = prof_bucket_top(b);
+            return top < p->max_us ? top : p->max_us;
+        }
+    }
+    return p->max_us;
+}
+
+typedef struct {
+    int slot;
+    uint32_t start;
+} prof_scope_t;
+
+static inline void prof_scope_end(prof_scope_t *sc) {
+    prof_record(sc->slot, (esp_cpu_get_cycle_count() - sc->start) / PROF_CPU_MHZ);
+}
+
+#define PROF_SCOPE(slot) \
+    prof_scope_t __attribute__((cleanup(prof_scope_end))) prof_scope_##slot = { slot, esp_cpu_get_cycle_count() }
+#define PROF_START(var)        uint32_t var = esp_cpu_get_cycle_count()
+#define PROF_STOP(slot, var)   prof_record(slot, (esp_cpu_get_cycle_count() - (var)) / PROF_CPU_MHZ)
+
+static int prof_task_stats(char *buf, int len) {
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_USE_TRACE_FACILITY
+    static TaskStatus_t ts[PROF_MAX_TASKS];
+    configRUN_TIME_COUNTER_TYPE total;
+    UBaseType_t n = uxTaskGetSystemState(ts, PROF_MAX_TASKS, &total);
+    int used = 0;
+    for (UBaseType_t i = 0; i < n && total > 0 && used < len; i++) {
+        used += snprintf(buf + used, len - used, "%-12s %3lu%%\n", ts[i].pcTaskName,
+                         (unsigned long)((uint64_t)ts[i].ulRunTimeCounter * 100 / total));
+    }
+    return used < len ? used : len - 1;
+#else
+    return snprintf(buf, len, "(enable FreeRTOS run-time stats)\n");
+#endif
+}
+
+static int prof_format(char *buf, int len) {
+    int used = 0;
+    for (int i = 0; i < PROF_SLOTS && used < len; i++) {
+        prof_stat_t *p = &prof[i];
+        if (!p->count) continue;
+        used += snprintf(buf + used, len - used, "%-10s n=%lu %lu/%lu/%lu us\n", PROF_NAMES[i],
+                         (unsigned long)p->count, (unsigned long)(p->total_us / p->count),
+                         (unsigned long)prof_percentile(p, 99), (unsigned long)p->max_us);
+    }
+    if (used == 0) used = snprintf(buf, len, "(no samples yet)\n");
+    return used < len ? used : len - 1;
+}
+
+static void prof_poll(int64_t now_ms) {
+    static int64_t last_ms = 0;
+    static char buf[PROF_MAX_TASKS * 24];
+    if (now_ms - last_ms < PROFILE_DUMP_MS) return;
+    last_ms = now_ms;
+
+    prof_format(buf, sizeof(buf));
+    ESP_LOGI("PROF", "Last %d s, avg/p99/max:\n%s", PROFILE_DUMP_MS / 1000, buf);
+    prof_task_stats(buf, sizeof(buf));
+    ESP_LOGI("PROF", "CPU per task:\n%s", buf);
+    memset(prof, 0, sizeof(prof));
+}
+#else
+#define PROF_SCOPE(slot)       ((void)0)
+#define PROF_START(var)        ((void)0)
+#define PROF_STOP(slot, var)   ((void)0)
+#define prof_record(slot, us)  ((void)0)
+#define prof_poll(now_ms)      ((void)0)
+#endif
+
+// --- POWER ---
+// Between loop iterations the C3 light-sleeps (esp_pm plus tickless idle)
+// and the radio sits in modem sleep. ESP-NOW only hears frames while the
+// radio is up, so it stays up for RADIO_LISTEN_MS after each transmission;
+// the receiver answers, and hands over any queued commands, right then.
+// OTA and research capture hold it up for their whole run. A short wake
+// window every RADIO_WAKE_EVERY_MS catches anything sent out of turn.
+#define RADIO_HOLD_ALWAYS  0x01    // POWER_SAVE off
+#define RADIO_HOLD_OTA     0x02
+#define RADIO_HOLD_CAPTURE 0x04
+
+// Energy accounting. In RTC memory so a not-worn deep sleep adds to the
+// totals instead of starting them over; a reset or power cycle clears them.
+typedef struct {
+    uint64_t awake_us;     // Not in deep sleep: running or light-sleeping
+    uint64_t busy_us;      // CPU running
+    uint64_t radio_us;     // Radio held up: listen windows, OTA, capture
+    uint64_t motor_us;
+    uint64_t deep_us;
+    uint32_t tx_frames;
+    uint32_t wakes;        // Deep sleeps ended by motion
+} energy_t;
+
+static RTC_DATA_ATTR energy_t energy;
+static SemaphoreHandle_t radio_lock;
+static esp_timer_handle_t radio_listen_timer;
+static volatile uint8_t radio_holds = POWER_SAVE ? 0 : RADIO_HOLD_ALWAYS;
+static bool radio_up = true;
+static int64_t radio_up_since = 0;
+static bool light_sleep_on = false;
+
+// Call with radio_lock held
+static void radio_set(bool up) {
+    if (up == radio_up) return;
+    int64_t now = esp_timer_get_time();
+    if (radio_up) energy.radio_us += now - radio_up_since;
+    else radio_up_since = now;
+    radio_up = up;
+    esp_wifi_set_ps(up ? WIFI_PS_NONE : WIFI_PS_MIN_MODEM);
+}
+
+static void radio_listen_end_cb(void *arg) {
+    xSemaphoreTake(radio_lock, portMAX_DELAY);
+    if (!radio_holds) radio_set(false);
+    xSemaphoreGive(radio_lock);
+}
+
+// After a transmission: stay up for the receiver's answer
+static void radio_listen(void) {
+    xSemaphoreTake(radio_lock, portMAX_DELAY);
+    radio_set(true);
+    esp_timer_stop(radio_listen_timer);
+    esp_timer_start_once(radio_listen_timer, RADIO_LISTEN_MS * 1000);
+    xSemaphoreGive(radio_lock);
+}
+
+static void radio_hold(uint8_t who, bool hold) {
+    xSemaphoreTake(radio_lock, portMAX_DELAY);
+    radio_holds = hold ? (radio_holds | who) : (radio_holds & ~who);
+    if (radio_holds) radio_set(true);
+    else if (!esp_timer_is_active(radio_listen_timer)) radio_set(false);
+    xSemaphoreGive(radio_lock);
+}
+
+// Wi-Fi task; counts frames actually handed to the air
+static void on_sent(const uint8_t *mac, esp_now_send_status_t status) {
+    energy.tx_frames++;
+}
+
+// Appends the frame sequence number: one per transmission, retransmits
+// included, so a relay can tell a copy it already passed on from a resend.
+// Random start, so a reboot does not repeat what relays saw just before.
+static atomic_uint frame_seq;
+
+static esp_err_t frame_send(const uint8_t *mac, const void *frame, size_t len) {
+    uint8_t buf[ESP_NOW_MAX_DATA_LEN];
+    if (len + sizeof(uint16_t) > sizeof(buf)) return ESP_ERR_INVALID_SIZE;
+    uint16_t seq = (uint16_t) atomic_fetch_add(&frame_seq, 1);
+    memcpy(buf, frame, len);
+    memcpy(buf + len, &seq, sizeof(seq));
+    return esp_now_send(mac, buf, len + sizeof(seq));
+}
+
+// After Wi-Fi starts, before ESP-NOW can deliver anything
+static void power_init(void) {
+    radio_lock = xSemaphoreCreateMutex();
+    const esp_timer_create_args_t args = { .callback = radio_listen_end_cb, .name = "radio_listen" };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &radio_listen_timer));
+    radio_up_since = esp_timer_get_time();
+    if (!POWER_SAVE) {
+        esp_wifi_set_ps(WIFI_PS_NONE);
+        return;
+    }
+    esp_wifi_connectionless_module_set_wake_interval(RADIO_WAKE_EVERY_MS);
+    radio_hold(0, false);
+
+    esp_pm_config_t pm = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = 40,                 // XTAL
+        .light_sleep_enable = true,
+    };
+    light_sleep_on = esp_pm_configure(&pm) == ESP_OK;
+    if (!light_sleep_on) {
+        ESP_LOGW("ENERGY", "No light sleep (enable CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE)");
+    }
+}
+
+// Once per loop, just before the delay. CPU time comes from the idle
+// task's run-time counter when FreeRTOS keeps one, so every task and the
+// Wi-Fi stack count; otherwise only the main loop's own work does.
+static void energy_tick(int64_t loop_start_us) {
+    static int64_t last_us = 0;
+    int64_t now = esp_timer_get_time();
+    energy.awake_us += now - last_us;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    static configRUN_TIME_COUNTER_TYPE idle_last = 0;
+    configRUN_TIME_COUNTER_TYPE idle = ulTaskGetIdleRunTimeCounter();
+    uint32_t idle_us = (uint32_t)(idle - idle_last);       // esp_timer based, us
+    idle_last = idle;
+    if (idle_us < now - last_us) energy.busy_us += now - last_us - idle_us;
+#else
+    energy.busy_us += now - loop_start_us;
+#endif
+    last_us = now;
+}
+
+// Totals since power-up and the charge they add up to, per consumer
+static void energy_poll(int64_t now_ms) {
+    static int64_t last_ms = 0;
+    if (now_ms - last_ms < ENERGY_LOG_MS) return;
+    last_ms = now_ms;
+
+    xSemaphoreTake(radio_lock, portMAX_DELAY);
+    uint64_t radio_us = energy.radio_us + (radio_up ? esp_timer_get_time() - radio_up_since : 0);
+    xSemaphoreGive(radio_lock);
+    // Dozing in modem sleep the radio still opens its wake window
+    uint64_t doze_us = energy.awake_us > radio_us ? energy.awake_us - radio_us : 0;
+    float radio_s = (radio_us + doze_us * RADIO_WAKE_WINDOW_MS / RADIO_WAKE_EVERY_MS) / 1e6f;
+    float awake_s = energy.awake_us / 1e6f, busy_s = energy.busy_us / 1e6f;
+    float motor_s = energy.motor_us / 1e6f, deep_s = energy.deep_us / 1e6f;
+
+    float cpu = (busy_s * I_CPU_MA + (awake_s - busy_s) * (light_sleep_on ? I_LIGHT_MA : I_CPU_MA)) / 3600;
+    float radio = radio_s * I_RADIO_MA / 3600;
+    float sensor = awake_s * I_SENSOR_MA / 3600;
+    float motor = motor_s * I_MOTOR_MA / 3600;
+    float deep = deep_s * I_DEEP_MA / 3600;
+    float total = cpu + radio + sensor + motor + deep;
+    float avg_ma = total * 3600 / (awake_s + deep_s);
+
+    ESP_LOGI("ENERGY", "awake %.0f s (busy %.1f%%), radio ~%.1f s, motor %.1f s, deep sleep %.0f s in %lu, %lu tx",
+             awake_s, awake_s > 0 ? busy_s * 100 / awake_s : 0, radio_s, motor_s, deep_s,
+             (unsigned long)energy.wakes, (unsigned long)energy.tx_frames);
+    ESP_LOGI("ENERGY", "~%.2f mAh (cpu %.2f, radio %.2f, sensor %.2f, motor %.2f, deep %.3f), avg %.2f mA, ~%.0f h on %d mAh",
+             total, cpu, radio, sensor, motor, deep, avg_ma, BATTERY_MAH / avg_ma, BATTERY_MAH);
+}
 
 // --- I2C / MPU6050 ---
 #define MPU6050_ADDR       0x68
+#define MPU_REG_WHO_AM_I   0x75
+#define MPU_REG_CONFIG     0x1A
+#define MPU_DLPF_POSTURE   0x04    // 21 Hz: the ~200 Hz motor buzz is well into the stopband
+#define MPU_REG_ACCEL_CONFIG 0x1C
+#define MPU_REG_MOT_THR    0x1F
+#define MPU_REG_MOT_DUR    0x20
+#define MPU_REG_INT_PIN_CFG 0x37
+#define MPU_REG_INT_ENABLE 0x38
+#define MPU_REG_INT_STATUS 0x3A
+#define MPU_REG_PWR_MGMT_1 0x6B
+#define MPU_REG_PWR_MGMT_2 0x6C
 #define RAD_TO_DEG         57.2957795131
 
+// Accelerometer angles plus gyro rates from one burst read
+typedef struct {
+    float pitch, roll;     // deg, from gravity
+    float rate_p, rate_r;  // deg/s, raw gyro (bias not removed)
+    bool acc_ok;           // |a| close enough to 1 g for the angles to mean tilt
+    int16_t acc_mg[3];     // Fixed-point copies for the activity classifier
+    int16_t gyro_ddps[3];  // 0.1 deg/s
+} imu_reading_t;
+
 static void i2c_init(void) {
     i2c_config_t conf = {
         .mode = I2C_MODE_MASTER,
@@ -62,37 +676,1503 @@ static void i2c_init(void) {
     i2c_driver_install(0, conf.mode, 0, 0, 0);
 }
 
-static void mpu_wake(void) {
-    uint8_t data[2] = {0x6B, 0x00}; 
+static void mpu_write(uint8_t reg, uint8_t val) {
+    uint8_t data[2] = { reg, val };
     i2c_master_write_to_device(0, MPU6050_ADDR, data, 2, 100);
 }
 
-static void read_mpu_data(float *p, float *r) {
-    uint8_t data[6];
+// Also undoes the wake-on-motion setup left from a not-worn deep sleep
+static void mpu_wake(void) {
+    mpu_write(MPU_REG_PWR_MGMT_1, 0x00);
+    mpu_write(MPU_REG_PWR_MGMT_2, 0x00);
+    mpu_write(MPU_REG_INT_ENABLE, 0x00);
+    mpu_write(MPU_REG_ACCEL_CONFIG, 0x00);
+    mpu_write(MPU_REG_CONFIG, MPU_DLPF_POSTURE);
+    uint8_t reg = MPU_REG_INT_STATUS, st;
+    i2c_master_write_read_device(0, MPU6050_ADDR, &reg, 1, &st, 1, 100);    // Releases a latched INT
+}
+
+// Accel, temperature and gyro in one 14-byte burst
+static bool read_mpu_data(imu_reading_t *m) {
+    PROF_SCOPE(PROF_MPU_READ);
+    uint8_t data[14];
     uint8_t reg = 0x3B; 
-    if (i2c_master_write_read_device(0, MPU6050_ADDR, &reg, 1, data, 6, 100) == ESP_OK) {
+    if (i2c_master_write_read_device(0, MPU6050_ADDR, &reg, 1, data, 14, 100) == ESP_OK) {
         int16_t ax = (int16_t)((data[0] << 8) | data[1]);
         int16_t ay = (int16_t)((data[2] << 8) | data[3]);
         int16_t az = (int16_t)((data[4] << 8) | data[5]);
+        int16_t gx = (int16_t)((data[8] << 8) | data[9]);
+        int16_t gy = (int16_t)((data[10] << 8) | data[11]);
+        int16_t gz = (int16_t)((data[12] << 8) | data[13]);
+        m->acc_mg[0] = (ax * 1000) >> 14;
+        m->acc_mg[1] = (ay * 1000) >> 14;
+        m->acc_mg[2] = (az * 1000) >> 14;
+        m->gyro_ddps[0] = gx * 10 / 131;
+        m->gyro_ddps[1] = gy * 10 / 131;
+        m->gyro_ddps[2] = gz * 10 / 131;
         float x = ax / 16384.0;
         float y = ay / 16384.0;
         float z = az / 16384.0;
-        *p = atan2(-x, sqrt(y*y + z*z)) * RAD_TO_DEG;
-        *r = atan2(y, z) * RAD_TO_DEG;
+        m->pitch = atan2(-x, sqrt(y*y + z*z)) * RAD_TO_DEG;
+        m->roll = atan2(y, z) * RAD_TO_DEG;
+        m->rate_p = gy / GYRO_LSB_PER_DPS;
+        m->rate_r = gx / GYRO_LSB_PER_DPS;
+        float g2 = x*x + y*y + z*z;
+        m->acc_ok = fabsf(g2 - 1.0f) < FUSION_ACC_TOL_G2;
+        // Registers read back zero until the first conversion after wake
+        return g2 > 0.25f && g2 < 4.0f;
+    }
+    return false;
+}
+
+// --- ORIENTATION ---
+// Complementary filter: the gyro carries short-term motion and the
+// accelerometer slowly pulls out drift. While the motor runs (and briefly
+// after) the accelerometer is mostly motor noise, so its weight drops to
+// zero and the gyro alone carries the angle; a 250 ms pulse costs well
+// under a degree of drift. Replaces the old blind period, so readings keep
+// flowing during feedback and straightening up is seen immediately.
+static struct {
+    bool init;
+    float pitch, roll;
+    float bias_p, bias_r;  // deg/s
+    int64_t last_us;
+} fusion;
+
+static void fusion_reset(const imu_reading_t *m) {
+    fusion.init = true;
+    fusion.pitch = m->pitch;
+    fusion.roll = m->roll;
+    fusion.last_us = esp_timer_get_time();
+}
+
+static void fusion_update(const imu_reading_t *m, bool haptic, int64_t now_us) {
+    if (!fusion.init) {
+        fusion_reset(m);
+        return;
+    }
+    float dt = (now_us - fusion.last_us) / 1e6f;
+    fusion.last_us = now_us;
+    float rp = m->rate_p - fusion.bias_p;
+    float rr = m->rate_r - fusion.bias_r;
+
+    // Slow bias tracking while sitting still, never under the motor
+    if (!haptic && fabsf(rp) < GYRO_STILL_DPS && fabsf(rr) < GYRO_STILL_DPS) {
+        fusion.bias_p += rp / 64;
+        fusion.bias_r += rr / 64;
+    }
+
+    fusion.pitch += rp * dt;
+    fusion.roll += rr * dt;
+    if (!haptic && m->acc_ok) {
+        fusion.pitch = FUSION_GYRO_SHARE * fusion.pitch + (1 - FUSION_GYRO_SHARE) * m->pitch;
+        fusion.roll = FUSION_GYRO_SHARE * fusion.roll + (1 - FUSION_GYRO_SHARE) * m->roll;
+    }
+}
+
+// --- ACTIVITY CLASSIFIER ---
+// Sliding-window features, all integer and O(1) per sample: variance of
+// the acceleration magnitude, mean gyro energy and mean squared jerk.
+// Any of them high means the wearer is moving (walking, reaching,
+// bending), which gates the slouch detector. Otherwise a little sway says
+// standing, none says sitting. Moving is entered on one window, left only
+// after ACT_HOLD calmer ones.
+typedef enum { ACT_SITTING = 0, ACT_STANDING = 1, ACT_MOVING = 2 } activity_t;
+
+static const char *ACT_NAMES[] = { "sitting", "standing", "moving" };
+static const uint16_t ACT_PERIOD_MS[] = { 100, 100, 200 };     // Loop period per activity
+
+static struct {
+    int16_t mag[ACT_WINDOW];
+    uint32_t mag2[ACT_WINDOW], gyro[ACT_WINDOW], jerk[ACT_WINDOW];
+    int32_t sum_mag;
+    uint32_t sum_mag2, sum_gyro, sum_jerk;
+    int16_t last_acc[3];
+    uint8_t idx, filled, hold;
+    activity_t state;
+} act;
+
+static uint32_t isqrt32(uint32_t x) {
+    uint32_t r = 0, bit = 1u << 30;
+    while (bit > x) bit >>= 2;
+    while (bit) {
+        if (x >= r + bit) {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        }
+        else r >>= 1;
+        bit >>= 2;
+    }
+    return r;
+}
+
+static activity_t activity_classify(void) {
+    int64_t n = act.filled;
+    uint32_t var = (n * act.sum_mag2 - (int64_t)act.sum_mag * act.sum_mag) / (n * n);
+    if (var > ACT_MOVE_VAR || act.sum_gyro / n > ACT_MOVE_GYRO || act.sum_jerk / n > ACT_MOVE_JERK) {
+        return ACT_MOVING;
+    }
+    return var > ACT_SWAY_VAR ? ACT_STANDING : ACT_SITTING;
+}
+
+// Returns true when the activity changed
+static bool activity_update(const imu_reading_t *m) {
+    const int16_t *a = m->acc_mg, *g = m->gyro_ddps;
+    int32_t dx = a[0] - act.last_acc[0], dy = a[1] - act.last_acc[1], dz = a[2] - act.last_acc[2];
+    bool first = act.filled == 0;
+    memcpy(act.last_acc, a, sizeof(act.last_acc));
+
+    int i = act.idx;
+    if (act.filled == ACT_WINDOW) {        // Oldest sample leaves the sums
+        act.sum_mag -= act.mag[i];
+        act.sum_mag2 -= act.mag2[i];
+        act.sum_gyro -= act.gyro[i];
+        act.sum_jerk -= act.jerk[i];
+    }
+    else act.filled++;
+    act.mag[i] = isqrt32(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+    act.mag2[i] = act.mag[i] * act.mag[i];
+    act.gyro[i] = g[0] * g[0] + g[1] * g[1] + g[2] * g[2];
+    act.jerk[i] = first ? 0 : dx * dx + dy * dy + dz * dz;
+    act.sum_mag += act.mag[i];
+    act.sum_mag2 += act.mag2[i];
+    act.sum_gyro += act.gyro[i];
+    act.sum_jerk += act.jerk[i];
+    act.idx = (i + 1) % ACT_WINDOW;
+
+    activity_t c = activity_classify();
+    if (c == act.state) {
+        act.hold = 0;
+        return false;
+    }
+    if (c != ACT_MOVING && ++act.hold < ACT_HOLD) return false;
+    act.hold = 0;
+    act.state = c;
+    return true;
+}
+
+// --- HAPTICS ---
+// The pulse is timed by esp_timer so the main loop keeps sensing under it.
+static esp_timer_handle_t haptic_timer;
+static volatile int64_t haptic_quiet_us = 0;   // Accelerometer trustworthy again from here
+
+static void haptic_off_cb(void *arg) {
+    gpio_set_level(VIB_MOTOR_PIN, 0);
+}
+
+static void haptic_init(void) {
+    const esp_timer_create_args_t args = { .callback = haptic_off_cb, .name = "haptic" };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &haptic_timer));
+}
+
+static void haptic_pulse(uint32_t pulse_ms) {
+    if (!vibration_enabled) return;
+    esp_timer_stop(haptic_timer);
+    gpio_set_level(VIB_MOTOR_PIN, 1);
+    esp_timer_start_once(haptic_timer, pulse_ms * 1000);
+    energy.motor_us += pulse_ms * 1000;
+    haptic_quiet_us = esp_timer_get_time() + (pulse_ms + HAPTIC_SETTLE_MS) * 1000LL;
+}
+
+static bool haptic_active(int64_t now_us) {
+    return now_us < haptic_quiet_us;
+}
+
+// Runs alongside the radio bring-up. Checks the sensor answers, wakes it
+// and waits for a reading that looks like gravity before releasing app_main.
+static void sensor_init_task(void *arg) {
+    TaskHandle_t main_task = arg;
+    int64_t t = esp_timer_get_time();
+    i2c_init();
+
+    uint8_t reg = MPU_REG_WHO_AM_I, who = 0;
+    if (i2c_master_write_read_device(0, MPU6050_ADDR, &reg, 1, &who, 1, 100) != ESP_OK) {
+        ESP_LOGE(TAG, "MPU6050 not responding");
+    } else if (who != 0x68) {
+        ESP_LOGW(TAG, "Unexpected WHO_AM_I 0x%02X", who);
+    }
+    mpu_wake();
+    t = boot_phase("sensor wake", t);
+
+    imu_reading_t m;
+    int64_t deadline = t + SENSOR_READY_MS * 1000LL;
+    while (!read_mpu_data(&m) && esp_timer_get_time() < deadline) {
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    boot_phase("first reading", t);
+    xTaskNotifyGive(main_task);
+    vTaskDelete(NULL);
+}
+
+// --- RESEARCH CAPTURE ---
+// The MPU6050 samples into its FIFO at the capture rate and capture_task
+// drains it every CAPTURE_POLL_MS. Raw mode batches the samples as read.
+// Filtered mode runs the accelerometer through an integer chain (3rd-order
+// CIC decimator, then a 3-tap FIR undoing the CIC's passband droop) and
+// turns only the decimated output into angles, so the C3's soft-float
+// math runs at the output rate, not the sample rate. The normal posture
+// loop keeps reading its own registers alongside.
+#define MPU_REG_SMPLRT_DIV 0x19
+#define MPU_REG_FIFO_EN    0x23
+#define MPU_REG_USER_CTRL  0x6A
+#define MPU_REG_FIFO_COUNT 0x72
+#define MPU_REG_FIFO_RW    0x74
+#define MPU_FIFO_SAMPLE    12      // Accel xyz + gyro xyz, big-endian int16
+#define MPU_FIFO_READ_MAX  (20 * MPU_FIFO_SAMPLE)
+#define CIC_ORDER          3
+
+static volatile uint8_t capture_mode = CAPTURE_OFF;
+static volatile uint16_t capture_odr = CAPTURE_ODR_HZ;
+static volatile uint8_t capture_decim = CAPTURE_DECIM;
+static volatile uint8_t capture_gen = 0;    // Bumped by every capture command
+static int64_t capture_drained_us;          // FIFO last emptied, capture task only
+static TaskHandle_t capture_task_handle;
+
+// Integrators run at the input rate, combs at the output rate. Unsigned so
+// the wrap-around CIC relies on is defined behaviour.
+typedef struct {
+    uint32_t integ[CIC_ORDER];
+    uint32_t comb[CIC_ORDER];
+} cic_t;
+
+static struct {
+    cic_t cic[3];
+    int32_t fir[3][2];         // Last two CIC outputs per axis
+    uint8_t phase;
+    uint8_t decim;
+    int32_t gain;              // decim^CIC_ORDER
+    uint8_t warm;              // Outputs seen, until the CIC and FIR have settled
+} chain;
+
+static struct {
+    uint32_t cycles, samples, frames, dropped, overflows;
+    int64_t last_ms;
+} capture_bench;
+
+static void capture_sensor_start(uint16_t odr_hz) {
+    mpu_write(MPU_REG_CONFIG, 0x01);                    // DLPF 184 Hz, gyro clocked at 1 kHz
+    mpu_write(MPU_REG_SMPLRT_DIV, 1000 / odr_hz - 1);
+    mpu_write(MPU_REG_FIFO_EN, 0x00);
+    mpu_write(MPU_REG_USER_CTRL, 0x04);                 // FIFO reset
+    mpu_write(MPU_REG_FIFO_EN, 0x78);                   // Accel + gyro
+    mpu_write(MPU_REG_USER_CTRL, 0x40);                 // FIFO on
+}
+
+static void capture_sensor_stop(void) {
+    mpu_write(MPU_REG_FIFO_EN, 0x00);
+    mpu_write(MPU_REG_USER_CTRL, 0x04);
+    mpu_write(MPU_REG_CONFIG, MPU_DLPF_POSTURE);        // Back to the posture loop's setup
+    mpu_write(MPU_REG_SMPLRT_DIV, 0x00);
+}
+
+static void chain_reset(uint8_t decim) {
+    memset(&chain, 0, sizeof(chain));
+    chain.decim = decim;
+    chain.gain = decim * decim * decim;
+}
+
+// One accelerometer sample in; true with out[] set every decim samples
+static inline bool chain_push(const int16_t a[3], int32_t out[3]) {
+    for (int i = 0; i < 3; i++) {
+        cic_t *c = &chain.cic[i];
+        c->integ[0] += (uint32_t)(int32_t)a[i];
+        c->integ[1] += c->integ[0];
+        c->integ[2] += c->integ[1];
+    }
+    if (++chain.phase < chain.decim) return false;
+    chain.phase = 0;
+
+    // Drop the first outputs while the comb and FIR fill from zero
+    bool ready = chain.warm > CIC_ORDER + 1;
+    if (!ready) chain.warm++;
+    for (int i = 0; i < 3; i++) {
+        cic_t *c = &chain.cic[i];
+        uint32_t y = c->integ[2];
+        for (int k = 0; k < CIC_ORDER; k++) {
+            uint32_t d = y - c->comb[k];
+            c->comb[k] = y;
+            y = d;
+        }
+        int32_t x = (int32_t)y / chain.gain;
+        // Droop compensation, (-1, 10, -1) / 8: unity at DC, +3.5 dB at Nyquist
+        int32_t *h = chain.fir[i];
+        out[i] = (10 * h[0] - h[1] - x) >> 3;
+        h[1] = h[0];
+        h[0] = x;
+    }
+    return ready;
+}
+
+static void capture_send(capture_frame_t *f, int words) {
+    size_t len = offsetof(capture_frame_t, data) + words * sizeof(int16_t);
+    if (frame_send(BROADCAST_MAC, f, len) == ESP_OK) capture_bench.frames++;
+    else capture_bench.dropped++;
+    f->sample += f->count;
+    f->count = 0;
+}
+
+// Samples per frame for the mode: 6 words raw, 2 words filtered
+static int capture_per_frame(uint8_t mode) {
+    return mode == CAPTURE_RAW ? CAPTURE_WORDS / 6 : CAPTURE_WORDS / 2;
+}
+
+// FIFO overflowed: everything since the last drain is gone. Send what we
+// have, skip the index past the estimated loss and restart the chain, so
+// the host sees a gap instead of two segments joined (and blended by the
+// CIC) under consecutive indices.
+static void capture_overflow(capture_frame_t *f, int64_t now_us) {
+    capture_bench.overflows++;
+    mpu_write(MPU_REG_USER_CTRL, 0x44);
+    if (f->count) capture_send(f, f->count * (f->mode == CAPTURE_RAW ? 6 : 2));
+    uint32_t lost = (uint32_t)((now_us - capture_drained_us) * f->rate_hz / 1000000);
+    if (f->mode == CAPTURE_FILTERED) {
+        lost += CIC_ORDER + 2;          // Outputs chain_push drops while it settles again
+        chain_reset(chain.decim);
+    }
+    f->sample += lost;
+    capture_drained_us = now_us;
+}
+
+static void capture_drain(capture_frame_t *f) {
+    PROF_SCOPE(PROF_CAPTURE);
+    uint8_t buf[MPU_FIFO_READ_MAX], reg = MPU_REG_INT_STATUS, st = 0;
+    i2c_master_write_read_device(0, MPU6050_ADDR, &reg, 1, &st, 1, 100);
+    if (st & 0x10) {
+        capture_overflow(f, esp_timer_get_time());
+        return;
+    }
+    reg = MPU_REG_FIFO_COUNT;
+    uint8_t cnt[2];
+    if (i2c_master_write_read_device(0, MPU6050_ADDR, &reg, 1, cnt, 2, 100) != ESP_OK) return;
+    int avail = ((cnt[0] << 8) | cnt[1]) / MPU_FIFO_SAMPLE * MPU_FIFO_SAMPLE;
+    int per_frame = capture_per_frame(f->mode);
+
+    while (avail > 0) {
+        int n = avail > MPU_FIFO_READ_MAX ? MPU_FIFO_READ_MAX : avail;
+        reg = MPU_REG_FIFO_RW;
+        if (i2c_master_write_read_device(0, MPU6050_ADDR, &reg, 1, buf, n, 100) != ESP_OK) return;
+        avail -= n;
+
+        uint32_t c0 = esp_cpu_get_cycle_count();
+        for (const uint8_t *p = buf; p < buf + n; p += MPU_FIFO_SAMPLE) {
+            int16_t v[6];
+            for (int k = 0; k < 6; k++) v[k] = (int16_t)((p[2 * k] << 8) | p[2 * k + 1]);
+            if (f->mode == CAPTURE_RAW) {
+                memcpy(&f->data[f->count * 6], v, sizeof(v));
+                f->count++;
+            }
+            else {
+                int32_t a[3];
+                if (!chain_push(v, a)) continue;
+                float x = a[0], y = a[1], z = a[2];
+                float pitch = atan2f(-x, sqrtf(y * y + z * z)) * RAD_TO_DEG - offset_pitch;
+                float roll = atan2f(y, z) * RAD_TO_DEG - offset_roll;
+                f->data[f->count * 2] = (int16_t)(pitch * 100);
+                f->data[f->count * 2 + 1] = (int16_t)(roll * 100);
+                f->count++;
+            }
+            if (f->count == per_frame) {
+                capture_bench.cycles += esp_cpu_get_cycle_count() - c0;     // Radio time not counted
+                capture_send(f, per_frame * (f->mode == CAPTURE_RAW ? 6 : 2));
+                c0 = esp_cpu_get_cycle_count();
+            }
+        }
+        capture_bench.cycles += esp_cpu_get_cycle_count() - c0;
+        capture_bench.samples += n / MPU_FIFO_SAMPLE;
+    }
+    capture_drained_us = esp_timer_get_time();
+}
+
+// Per input sample: FIFO unpacking plus, when filtered, the chain and the
+// amortised angle maths. I2C and radio time are not included.
+static void capture_bench_poll(int64_t now_ms) {
+    if (now_ms - capture_bench.last_ms < CAPTURE_BENCH_MS) return;
+    if (capture_bench.samples) {
+        ESP_LOGI("CAPTURE", "%lu samples, %lu cycles/sample, %lu frames (%lu dropped), %lu FIFO overflows",
+                 (unsigned long)capture_bench.samples,
+                 (unsigned long)(capture_bench.cycles / capture_bench.samples),
+                 (unsigned long)capture_bench.frames, (unsigned long)capture_bench.dropped,
+                 (unsigned long)capture_bench.overflows);
+    }
+    memset(&capture_bench, 0, sizeof(capture_bench));
+    capture_bench.last_ms = now_ms;
+}
+
+static void capture_task(void *arg) {
+    static capture_frame_t f;
+    while (1) {
+        if (capture_mode == CAPTURE_OFF) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        uint8_t gen = capture_gen;
+        uint16_t odr = capture_odr;
+        memset(&f, 0, sizeof(f));
+        f.type = PKT_CAPTURE;
+        f.mode = capture_mode;
+        uint8_t decim = capture_decim;
+        while (odr % decim) decim--;        // Keep the output rate a whole number of Hz
+        chain_reset(decim);
+        f.rate_hz = f.mode == CAPTURE_RAW ? odr : odr / decim;
+        radio_hold(RADIO_HOLD_CAPTURE, true);
+        capture_sensor_start(odr);
+        capture_drained_us = esp_timer_get_time();
+        memset(&capture_bench, 0, sizeof(capture_bench));
+        capture_bench.last_ms = esp_timer_get_time() / 1000;
+        ESP_LOGI("CAPTURE", "%s at %u Hz", f.mode == CAPTURE_RAW ? "Raw" : "Filtered", f.rate_hz);
+
+        TickType_t wake = xTaskGetTickCount();
+        while (capture_gen == gen) {
+            vTaskDelayUntil(&wake, pdMS_TO_TICKS(CAPTURE_POLL_MS));
+            capture_drain(&f);
+            capture_bench_poll(esp_timer_get_time() / 1000);
+        }
+        capture_sensor_stop();
+        radio_hold(RADIO_HOLD_CAPTURE, false);
+        ESP_LOGI("CAPTURE", "Stopped");
+    }
+}
+
+static void capture_command(uint8_t id, uint8_t value) {
+    switch (id) {
+        case CMD_CAPTURE:
+            if (value > CAPTURE_FILTERED) return;
+            capture_mode = value;
+            break;
+        case CMD_CAPTURE_ODR:
+            // The sample rate divides the 1 kHz gyro clock
+            if (value < 1 || value > 100 || 100 % value) return;
+            capture_odr = value * 10;
+            break;
+        case CMD_CAPTURE_DECIM:
+            if (value < 2 || value > CAPTURE_DECIM_MAX) return;
+            capture_decim = value;
+            break;
+    }
+    capture_gen++;
+    xTaskNotifyGive(capture_task_handle);
+}
+
+// --- BATTERY MONITOR ---
+static adc_oneshot_unit_handle_t adc_handle;
+static adc_cali_handle_t adc_cali = NULL;
+static int battery_filt_mv = 0;
+static int64_t battery_last_us = 0;
+static uint8_t battery_pct = BATTERY_UNKNOWN;
+
+// Resting single-cell LiPo discharge curve, interpolated linearly.
+static const struct { int mv; int pct; } LIPO_CURVE[] = {
+    {4200, 100}, {4150, 95}, {4110, 90}, {4080, 85}, {4020, 80},
+    {3980, 70},  {3950, 60}, {3910, 50}, {3870, 40}, {3850, 30},
+    {3840, 20},  {3820, 15}, {3800, 10}, {3750, 5},  {3700, 2},
+    {3600, 0},
+};
+
+static uint8_t lipo_percent(int mv) {
+    const int n = sizeof(LIPO_CURVE) / sizeof(LIPO_CURVE[0]);
+    if (mv >= LIPO_CURVE[0].mv) return 100;
+    for (int i = 1; i < n; i++) {
+        if (mv >= LIPO_CURVE[i].mv) {
+            int span_mv  = LIPO_CURVE[i-1].mv - LIPO_CURVE[i].mv;
+            int span_pct = LIPO_CURVE[i-1].pct - LIPO_CURVE[i].pct;
+            return LIPO_CURVE[i].pct + (mv - LIPO_CURVE[i].mv) * span_pct / span_mv;
+        }
+    }
+    return 0;
+}
+
+static void battery_init(void) {
+    adc_oneshot_unit_init_cfg_t unit_cfg = { .unit_id = ADC_UNIT_1 };
+    ESP_ERROR_CHECK(adc_oneshot_new_unit(&unit_cfg, &adc_handle));
+
+    adc_oneshot_chan_cfg_t chan_cfg = {
+        .atten = ADC_ATTEN_DB_12,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    };
+    ESP_ERROR_CHECK(adc_oneshot_config_channel(adc_handle, BATTERY_ADC_CHAN, &chan_cfg));
+
+    adc_cali_curve_fitting_config_t cali_cfg = {
+        .unit_id = ADC_UNIT_1,
+        .chan = BATTERY_ADC_CHAN,
+        .atten = ADC_ATTEN_DB_12,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    };
+    if (adc_cali_create_scheme_curve_fitting(&cali_cfg, &adc_cali) != ESP_OK) {
+        ESP_LOGW(TAG, "No ADC calibration, battery level disabled");
+        adc_cali = NULL;
     }
 }
 
+// Call only while the motor is off, its current sags the cell voltage.
+static void battery_update(void) {
+    if (adc_cali == NULL) return;
+
+    int64_t now = esp_timer_get_time();
+    if (battery_pct != BATTERY_UNKNOWN && (now - battery_last_us) < BATTERY_SAMPLE_MS * 1000LL) return;
+    battery_last_us = now;
+
+    int sum = 0, n = 0, mv;
+    for (int i = 0; i < BATTERY_READS; i++) {
+        if (adc_oneshot_get_calibrated_result(adc_handle, adc_cali, BATTERY_ADC_CHAN, &mv) == ESP_OK) {
+            sum += mv; n++;
+        }
+    }
+    if (n == 0) return;
+
+    // 1/4 EMA: smooths load ripple without lagging real discharge
+    int cell_mv = (sum / n) * BATTERY_DIVIDER;
+    if (battery_filt_mv == 0) battery_filt_mv = cell_mv;
+    else battery_filt_mv += (cell_mv - battery_filt_mv) / 4;
+
+    battery_pct = lipo_percent(battery_filt_mv);
+}
+
+// --- TIME SYNC ---
+// The receiver's uptime is the shared clock. Each exchange is NTP-style:
+// t1 and t4 are our send and receive times, t2 and t3 the receiver's, so
+// offset = ((t2 - t1) + (t3 - t4)) / 2, wrong by at most half the round
+// trip. A line fitted through the last TSYNC_POINTS offsets follows the
+// crystals' relative drift (tens of ppm, a few ms a minute) in between.
+// Once locked that is a 2-byte request and a 14-byte reply a minute.
+typedef struct {
+    int64_t x_us;          // Local midpoint of the exchange
+    int64_t off_us;        // Receiver minus local
+} tsync_point_t;
+
+static struct {
+    tsync_point_t pts[TSYNC_POINTS];
+    uint8_t n, next;
+    int64_t ref_us, ref_off_us;    // Fit: offset = ref_off + drift * (t - ref)
+    double drift;
+    uint8_t seq;
+    int64_t t1_us;                 // Outstanding request, 0 if none
+    int64_t last_req_us;
+    // Written by on_recv, then reply set; tsync_poll takes it from there
+    volatile bool reply;
+    uint8_t reply_seq;
+    int64_t t2_us, t4_us;
+    uint32_t hold_us;
+} tsync = { .last_req_us = INT64_MIN / 2 };
+
+static int64_t reading_us;         // Local time of the latest IMU reading
+
+static int64_t tsync_offset(int64_t t_us) {
+    return tsync.ref_off_us + (int64_t)(tsync.drift * (t_us - tsync.ref_us));
+}
+
+// Shared clock in ms at local time t_us, 0 before the first exchange
+static uint32_t tsync_stamp(int64_t t_us) {
+    if (!tsync.n) return 0;
+    return (uint32_t)((t_us + tsync_offset(t_us)) / 1000);
+}
+
+// Least squares through the kept offsets, relative to the newest so the
+// sums stay small. Until they span a full period the slope is mostly
+// noise, so the fit is just their mean.
+static void tsync_fit(void) {
+    const tsync_point_t *last = &tsync.pts[(tsync.next + TSYNC_POINTS - 1) % TSYNC_POINTS];
+    double sx = 0, sy = 0, sxx = 0, sxy = 0, min_x = 0;
+    for (int i = 0; i < tsync.n; i++) {
+        double x = tsync.pts[i].x_us - last->x_us, y = tsync.pts[i].off_us - last->off_us;
+        sx += x; sy += y; sxx += x * x; sxy += x * y;
+        if (x < min_x) min_x = x;
+    }
+    double n = tsync.n, den = n * sxx - sx * sx, b = 0;
+    if (-min_x >= TSYNC_PERIOD_MS * 1000.0 && den > 0) b = (n * sxy - sx * sy) / den;
+    if (fabs(b) > TSYNC_MAX_PPM * 1e-6) b = 0;
+    tsync.ref_us = last->x_us;
+    tsync.ref_off_us = last->off_us + (int64_t)((sy - b * sx) / n);
+    tsync.drift = b;
+}
+
+static void tsync_add(int64_t t1, int64_t t2, uint32_t hold, int64_t t4) {
+    int64_t rtt = (t4 - t1) - hold;
+    if (rtt < 0 || rtt > TSYNC_MAX_RTT_US) return;
+    tsync_point_t p = { (t1 + t4) / 2, t2 + hold / 2 - (t1 + t4) / 2 };
+    int64_t miss_us = p.off_us - tsync_offset(p.x_us);
+    if (tsync.n && (miss_us > TSYNC_RESET_US || miss_us < -TSYNC_RESET_US)) {
+        ESP_LOGW("SYNC", "Receiver clock jumped, resyncing");
+        tsync.n = tsync.next = 0;
+    }
+    tsync.pts[tsync.next] = p;
+    tsync.next = (tsync.next + 1) % TSYNC_POINTS;
+    if (tsync.n < TSYNC_POINTS) tsync.n++;
+    tsync_fit();
+    if (tsync.n == TSYNC_LOCK) {
+        ESP_LOGI("SYNC", "Locked, round trip %lld us", (long long)rtt);
+    }
+}
+
+// Wi-Fi task
+static void tsync_reply(const time_sync_t *r, int64_t t4_us) {
+    if (tsync.reply) return;
+    tsync.reply_seq = r->seq;
+    tsync.t2_us = r->rx_us;
+    tsync.hold_us = r->hold_us;
+    tsync.t4_us = t4_us;
+    tsync.reply = true;
+}
+
+// Main loop: fold in an answer, and ask again when due. With no receiver
+// acking us only once a period, in case a relay box can answer.
+static void tsync_poll(int64_t now_us, bool reachable) {
+    if (tsync.reply) {
+        if (tsync.t1_us && tsync.reply_seq == tsync.seq) {
+            tsync_add(tsync.t1_us, tsync.t2_us, tsync.hold_us, tsync.t4_us);
+        }
+        tsync.t1_us = 0;
+        tsync.reply = false;
+    }
+    int64_t period_us = (reachable && tsync.n < TSYNC_LOCK ? TSYNC_FAST_MS : TSYNC_PERIOD_MS) * 1000LL;
+    if (now_us - tsync.last_req_us < period_us) return;
+    tsync.last_req_us = now_us;
+    time_req_t req = { PKT_TIME_REQ, ++tsync.seq };
+    tsync.t1_us = esp_timer_get_time();
+    frame_send(BROADCAST_MAC, &req, sizeof(req));
+    radio_listen();
+}
+
+// --- SAMPLE BATCHING ---
+// TX_POLICY_BATCH: a still wearer's samples cost about 3 bytes each instead
+// of a 14-byte frame, so one frame carries a couple of seconds of readings.
+static struct {
+    uint8_t buf[FRAME_MAX];
+    uint8_t len, count, state;
+    int16_t pitch_dd, roll_dd;     // Last sample, quantised
+    int64_t first_ms, last_ms;
+    uint8_t sent_battery, sent_activity;
+} batch = { .sent_battery = BATTERY_UNKNOWN, .sent_activity = 0xFF };
+
+static void batch_put_varint(uint32_t v) {
+    while (v >= 0x80) {
+        batch.buf[batch.len++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    batch.buf[batch.len++] = (uint8_t)v;
+}
+
+static void batch_put_delta(int16_t now, int16_t prev) {
+    int32_t d = (int32_t)now - prev;
+    batch_put_varint(((uint32_t)d << 1) ^ (uint32_t)(d >> 31));    // Zigzag: small either way
+}
+
+static int16_t batch_quantise(float deg) {
+    float dd = roundf(deg * 10.0f);
+    return dd > INT16_MAX ? INT16_MAX : dd < INT16_MIN ? INT16_MIN : (int16_t)dd;
+}
+
+static void batch_flush(void) {
+    if (!batch.count) return;
+    batch.buf[2] = batch.count;
+    frame_send(BROADCAST_MAC, batch.buf, batch.len);
+    radio_listen();
+    batch.count = 0;
+}
+
+static void batch_add(float pitch, float roll, uint8_t state, int64_t now_ms) {
+    int16_t p = batch_quantise(pitch), r = batch_quantise(roll);
+    if (batch.count && (state != batch.state || now_ms - batch.last_ms > BATCH_MAX_DT_MS
+                        || batch.len + BATCH_SAMPLE_MAX > sizeof(batch.buf) || batch.count == UINT8_MAX)) {
+        batch_flush();
+    }
+    if (!batch.count) {
+        uint8_t flags = 0;
+        uint32_t stamp = tsync_stamp(reading_us);
+        batch.len = 4;
+        if (battery_pct != batch.sent_battery) {
+            flags |= BATCH_HAS_BATTERY;
+            batch.buf[batch.len++] = batch.sent_battery = battery_pct;
+        }
+        if (act.state != batch.sent_activity) {
+            flags |= BATCH_HAS_ACTIVITY;
+            batch.buf[batch.len++] = batch.sent_activity = act.state;
+        }
+        if (stamp) {
+            flags |= BATCH_HAS_TIME;
+            memcpy(&batch.buf[batch.len], &stamp, 4);
+            batch.len += 4;
+        }
+        memcpy(&batch.buf[batch.len], &p, 2);
+        memcpy(&batch.buf[batch.len + 2], &r, 2);
+        batch.len += 4;
+        batch.buf[0] = PKT_BATCH;
+        batch.buf[1] = flags;
+        batch.buf[3] = batch.state = state;
+        batch.first_ms = now_ms;
+    } else {
+        batch_put_varint((uint32_t)(now_ms - batch.last_ms));
+        batch_put_delta(p, batch.pitch_dd);
+        batch_put_delta(r, batch.roll_dd);
+    }
+    batch.count++;
+    batch.pitch_dd = p;
+    batch.roll_dd = r;
+    batch.last_ms = now_ms;
+    if (now_ms - batch.first_ms >= BATCH_FLUSH_MS) batch_flush();
+}
+
+// --- SLOUCH DETECTOR ---
+typedef struct {
+    float enter_deg;
+    float exit_deg;
+    uint32_t dwell_ms;
+    uint32_t cooldown_ms;
+} detector_cfg_t;
+
+static detector_cfg_t det_cfg = { DET_ENTER_DEG, DET_EXIT_DEG, DET_DWELL_MS, DET_COOLDOWN_MS };
+// Written by on_recv, then pending set; detector_take copies it into det_cfg.
+// The lock keeps a new setting from landing mid-copy, since the receiver
+// sends all four back to back and none may be dropped.
+static portMUX_TYPE det_cfg_lock = portMUX_INITIALIZER_UNLOCKED;
+static detector_cfg_t det_cfg_next;
+static volatile bool det_cfg_pending;
+static posture_state_t det_state = POSTURE_GOOD;
+static int64_t det_pending_since = -1;      // ms the opposite condition started, -1 if none
+static int64_t det_last_alert_ms = INT64_MIN / 2;
+static uint8_t det_seq = 0;
+
+// Hysteresis band plus dwell: a reading has to sit past the far threshold
+// for dwell_ms before the state flips, so noise around 15 deg can't flicker.
+static bool detector_update(float pitch, int64_t now_ms) {
+    PROF_SCOPE(PROF_DETECT);
+    float a = fabsf(pitch);
+    bool crossing = (det_state == POSTURE_GOOD) ? (a > det_cfg.enter_deg) : (a < det_cfg.exit_deg);
+    if (!crossing) {
+        det_pending_since = -1;
+        return false;
+    }
+    if (det_pending_since < 0) det_pending_since = now_ms;
+    if (now_ms - det_pending_since < det_cfg.dwell_ms) return false;
+
+    det_state = (det_state == POSTURE_GOOD) ? POSTURE_SLOUCH : POSTURE_GOOD;
+    det_pending_since = -1;
+    det_seq++;
+    return true;
+}
+
+static bool detector_alert_due(int64_t now_ms) {
+    if (det_state != POSTURE_SLOUCH) return false;
+    if (now_ms - det_last_alert_ms < det_cfg.cooldown_ms) return false;
+    det_last_alert_ms = now_ms;
+    return true;
+}
+
+static bool detector_cfg_valid(const detector_cfg_t *c) {
+    return c->enter_deg >= DET_ENTER_MIN_DEG && c->enter_deg <= DET_ENTER_MAX_DEG
+        && c->exit_deg >= 1 && c->exit_deg < c->enter_deg
+        && c->dwell_ms >= DET_DWELL_MIN_MS && c->dwell_ms <= DET_DWELL_MAX_MS
+        && c->cooldown_ms >= DET_COOLDOWN_MIN_MS && c->cooldown_ms <= DET_COOLDOWN_MAX_MS;
+}
+
+// Wi-Fi task: the set a new setting builds on, including one still pending
+static detector_cfg_t detector_staged(void) {
+    portENTER_CRITICAL(&det_cfg_lock);
+    detector_cfg_t c = det_cfg_pending ? det_cfg_next : det_cfg;
+    portEXIT_CRITICAL(&det_cfg_lock);
+    return c;
+}
+
+// Wi-Fi task: take a changed setting only if the whole set still makes sense
+static void detector_apply(const detector_cfg_t *c) {
+    if (!detector_cfg_valid(c)) return;
+    portENTER_CRITICAL(&det_cfg_lock);
+    det_cfg_next = *c;
+    det_cfg_pending = true;
+    portEXIT_CRITICAL(&det_cfg_lock);
+}
+
+// Main loop: switch to a staged set, true if there was one
+static bool detector_take(void) {
+    if (!det_cfg_pending) return false;
+    portENTER_CRITICAL(&det_cfg_lock);
+    det_cfg = det_cfg_next;
+    det_cfg_pending = false;
+    portEXIT_CRITICAL(&det_cfg_lock);
+    return true;
+}
+
+static void detector_load(void) {
+    nvs_handle_t h;
+    if (nvs_open("detect", NVS_READONLY, &h) != ESP_OK) return;
+    detector_cfg_t c;
+    size_t len = sizeof(c);
+    if (nvs_get_blob(h, "cfg", &c, &len) == ESP_OK && len == sizeof(c) && detector_cfg_valid(&c)) det_cfg = c;
+    nvs_close(h);
+}
+
+static void detector_save(void) {
+    nvs_handle_t h;
+    if (nvs_open("detect", NVS_READWRITE, &h) != ESP_OK) return;
+    nvs_set_blob(h, "cfg", &det_cfg, sizeof(det_cfg));
+    nvs_commit(h);
+    nvs_close(h);
+}
+
+// --- SLOUCH FORECAST ---
+// Least-squares line through the last FORECAST_WINDOW_MS of |pitch|. If it
+// is rising fast enough to cross enter_deg within FORECAST_HORIZON_MS, the
+// wearer is starting to slouch and gets one short nudge. It re-arms once
+// they are back out of the lead band, so a slow lean can't buzz repeatedly.
+static struct {
+    int64_t t_ms[FORECAST_POINTS];
+    float deg[FORECAST_POINTS];
+    uint8_t n, next;
+    bool armed;
+} fc = { .armed = true };
+
+static void forecast_reset(void) {
+    fc.n = fc.next = 0;
+}
+
+static bool forecast_update(float pitch, int64_t now_ms) {
+    float a = fabsf(pitch);
+    fc.t_ms[fc.next] = now_ms;
+    fc.deg[fc.next] = a;
+    fc.next = (fc.next + 1) % FORECAST_POINTS;
+    if (fc.n < FORECAST_POINTS) fc.n++;
+
+    float lead_deg = det_cfg.enter_deg - FORECAST_LEAD_DEG;
+    if (det_state != POSTURE_GOOD || a < lead_deg) {
+        fc.armed = det_state == POSTURE_GOOD;
+        return false;
+    }
+    if (!FORECAST_ENABLED || !fc.armed) return false;
+
+    // Relative to now, in seconds, so the sums stay small in float
+    float sx = 0, sy = 0, sxx = 0, sxy = 0, span = 0;
+    int n = 0;
+    for (int i = 0; i < fc.n; i++) {
+        int64_t age = now_ms - fc.t_ms[i];
+        if (age > FORECAST_WINDOW_MS) continue;
+        float x = -age / 1000.0f, y = fc.deg[i];
+        sx += x; sy += y; sxx += x * x; sxy += x * y;
+        if (-x > span) span = -x;
+        n++;
+    }
+    float den = n * sxx - sx * sx;
+    if (n < FORECAST_MIN_PTS || span < FORECAST_WINDOW_MS / 2000.0f || den <= 0) return false;
+    float slope = (n * sxy - sx * sy) / den;       // deg/s
+    float level = (sy - slope * sx) / n;           // Fitted |pitch| now
+    if (slope < FORECAST_MIN_DPS || level >= det_cfg.enter_deg) return false;
+
+    float eta_s = (det_cfg.enter_deg - level) / slope;
+    if (eta_s * 1000 > FORECAST_HORIZON_MS) return false;
+    fc.armed = false;
+    ESP_LOGI(TAG, "Nudge: %.1f deg rising %.1f deg/s, crossing in %.1f s", level, slope, eta_s);
+    return true;
+}
+
+static void send_event(float pitch) {
+    batch_flush();      // Samples from before the transition must not land after it
+    posture_event_t ev = { .type = PKT_EVENT, .state = det_state, .seq = det_seq, .pitch = pitch,
+                           .t_ms = tsync_stamp(reading_us) };
+    frame_send(BROADCAST_MAC, &ev, sizeof(ev));
+    radio_listen();
+}
+
+// --- TRANSMIT POLICY ---
+static bool link_up = true;                // Assume a receiver until heartbeats go unanswered
+static float tx_last_pitch = 0, tx_last_roll = 0;
+static int64_t tx_last_hb_ms = INT64_MIN / 2;
+
+static void send_heartbeat(float pitch, float roll) {
+    heartbeat_packet_t hb = {
+        .type = PKT_HEARTBEAT,
+        .state = det_state,
+        .battery_pct = battery_pct,
+        // Samples pause while moving, so the receiver must expect heartbeats only
+        .hb_interval_ds = (tx_policy != TX_POLICY_STREAM || act.state == ACT_MOVING) ? HEARTBEAT_MS / 100 : 0,
+        .pitch = pitch,
+        .roll = roll,
+        .activity = act.state,
+        .t_ms = tsync_stamp(reading_us),
+    };
+    frame_send(BROADCAST_MAC, &hb, sizeof(hb));
+    radio_listen();
+}
+
+// Streams every loop, batches every loop's sample, or in event mode sends
+// only when something the receiver shows has moved. The heartbeat goes out
+// on its own clock either way, and at once when the activity changes so
+// the receiver's timeout follows.
+static void transmit(float pitch, float roll, bool state_changed, bool activity_changed, int64_t now_ms) {
+    PROF_SCOPE(PROF_TRANSMIT);
+    if (activity_changed || tx_policy != TX_POLICY_BATCH) batch_flush();
+    bool heartbeat = now_ms - tx_last_hb_ms >= HEARTBEAT_MS || activity_changed;
+    if (heartbeat) {
+        tx_last_hb_ms = now_ms;
+        send_heartbeat(pitch, roll);
+        tx_last_pitch = pitch;
+        tx_last_roll = roll;
+    }
+    if (!link_up) return;       // Heartbeats keep probing; the backlog covers the rest
+    if (act.state == ACT_MOVING && !state_changed) return;     // Not at the desk: the heartbeat is enough
+
+    if (tx_policy == TX_POLICY_BATCH) {
+        batch_add(pitch, roll, det_state, now_ms);     // Heartbeat or not, or the batch has a hole
+    }
+    else if (!heartbeat) {      // Otherwise the heartbeat carried this reading
+        if (tx_policy != TX_POLICY_STREAM && !state_changed
+            && fabsf(pitch - tx_last_pitch) <= tx_delta_deg
+            && fabsf(roll - tx_last_roll) <= tx_delta_deg) return;
+        posture_packet_t packet = { .type = PKT_SAMPLE, .state = det_state, .pitch = pitch, .roll = roll,
+                                    .t_ms = tsync_stamp(reading_us) };
+        frame_send(BROADCAST_MAC, &packet, sizeof(packet));
+        radio_listen();
+        tx_last_pitch = pitch;
+        tx_last_roll = roll;
+    }
+}
+
+// --- STORE AND FORWARD ---
+// Aggregates always go into the ring; absolute indices let the sync task
+// tell which records are still pending after the ring has wrapped.
+static backlog_rec_t backlog[BACKLOG_CAP];
+static uint32_t backlog_head = 0;          // Records ever written
+static uint32_t sync_cursor = 0;           // First record still owed to the receiver
+static uint32_t sync_end = 0;              // Records before this are owed, after it went live
+static SemaphoreHandle_t backlog_lock;
+static TaskHandle_t sync_task;
+
+static volatile int64_t link_last_ack_ms = 0;     // Only acks from rx_mac count
+static volatile uint16_t backlog_acked_seq = 0xFFFF;
+
+// The receiver we answer to: the first one to address us, kept until it
+// has been quiet for LINK_LOSS_MS. Others' commands are ignored meanwhile.
+static uint8_t rx_mac[6];
+static volatile bool rx_paired;
+static volatile int64_t rx_heard_ms;
+
+static struct {
+    int64_t start_ms;
+    float pitch_sum, roll_sum, max_abs;
+    uint16_t n, slouch_n;
+} agg = { .start_ms = -1 };
+
+static void backlog_log(float pitch, float roll, int64_t now_ms) {
+    PROF_SCOPE(PROF_BACKLOG);
+    if (agg.start_ms < 0) agg.start_ms = now_ms;
+    agg.pitch_sum += pitch;
+    agg.roll_sum += roll;
+    if (fabsf(pitch) > agg.max_abs) agg.max_abs = fabsf(pitch);
+    agg.n++;
+    if (det_state == POSTURE_SLOUCH) agg.slouch_n++;
+    if (now_ms - agg.start_ms < BACKLOG_PERIOD_MS) return;
+
+    backlog_rec_t r = {
+        .t_ms = (uint32_t) now_ms,
+        .pitch_dd = (int16_t) (agg.pitch_sum * 10 / agg.n),
+        .roll_dd = (int16_t) (agg.roll_sum * 10 / agg.n),
+        .max_pitch = (uint8_t) (agg.max_abs > 255 ? 255 : agg.max_abs),
+        .slouch_frac = (uint8_t) (agg.slouch_n * 255 / agg.n),
+    };
+    xSemaphoreTake(backlog_lock, portMAX_DELAY);
+    backlog[backlog_head % BACKLOG_CAP] = r;
+    backlog_head++;
+    xSemaphoreGive(backlog_lock);
+
+    memset(&agg, 0, sizeof(agg));
+    agg.start_ms = now_ms;
+}
+
+// First record newer than t, or the oldest one still in the ring.
+static uint32_t backlog_find(int64_t t_ms) {
+    uint32_t oldest = backlog_head > BACKLOG_CAP ? backlog_head - BACKLOG_CAP : 0;
+    uint32_t i = backlog_head;
+    while (i > oldest && backlog[(i - 1) % BACKLOG_CAP].t_ms > t_ms) i--;
+    return i;
+}
+
+static void link_update(int64_t now_ms) {
+    if (link_up && now_ms - link_last_ack_ms > LINK_LOSS_MS) {
+        link_up = false;
+        xSemaphoreTake(backlog_lock, portMAX_DELAY);
+        // Keep an unfinished sync's cursor; otherwise owe everything since the last ack
+        if (sync_cursor >= sync_end) sync_cursor = backlog_find(link_last_ack_ms);
+        xSemaphoreGive(backlog_lock);
+        ESP_LOGW(TAG, "Receiver lost, buffering");
+    }
+    else if (!link_up && now_ms - link_last_ack_ms <= LINK_LOSS_MS) {
+        link_up = true;
+        xSemaphoreTake(backlog_lock, portMAX_DELAY);
+        sync_end = backlog_head;
+        xSemaphoreGive(backlog_lock);
+        ESP_LOGI(TAG, "Receiver back, syncing %lu records", (unsigned long)(sync_end - sync_cursor));
+        xTaskNotifyGive(sync_task);
+    }
+    if (rx_paired && now_ms - rx_heard_ms > LINK_LOSS_MS) rx_paired = false;
+}
+
+// Stop-and-wait is enough: a 6 h backlog is under 200 frames.
+static void backlog_sync_task(void *arg) {
+    static backlog_frame_t f;
+    uint16_t seq = 0;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (link_up) {
+            xSemaphoreTake(backlog_lock, portMAX_DELAY);
+            uint32_t oldest = backlog_head > BACKLOG_CAP ? backlog_head - BACKLOG_CAP : 0;
+            if (sync_cursor < oldest) sync_cursor = oldest;   // Overwritten while away
+            int n = 0;
+            for (uint32_t i = sync_cursor; i < sync_end && n < BACKLOG_PER_FRAME; i++) {
+                f.rec[n++] = backlog[i % BACKLOG_CAP];
+            }
+            xSemaphoreGive(backlog_lock);
+            if (n == 0) break;
+
+            f.type = PKT_BACKLOG;
+            f.count = n;
+            f.seq = ++seq;
+            f.now_ms = (uint32_t) (esp_timer_get_time() / 1000);
+            size_t len = offsetof(backlog_frame_t, rec) + n * sizeof(backlog_rec_t);
+
+            bool acked = false;
+            for (int attempt = 0; attempt < BACKLOG_RETRIES && !acked; attempt++) {
+                frame_send(BROADCAST_MAC, &f, len);
+                radio_listen();
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BACKLOG_ACK_MS));
+                acked = (backlog_acked_seq == seq);
+            }
+            if (!acked) break;     // Gone again, link_update() will wake us
+
+            xSemaphoreTake(backlog_lock, portMAX_DELAY);
+            sync_cursor += n;
+            xSemaphoreGive(backlog_lock);
+        }
+    }
+}
+
+// --- NOT WORN ---
+// Lying on a desk the sensor is perfectly still, which a worn one never is
+// for long. After NOT_WORN_MS of that the C3 goes into deep sleep with the
+// MPU6050 in low-power wake-on-motion; picking the wearable up raises INT
+// and the C3 boots straight back in. Calibration, the receiver's settings,
+// the gyro bias and the energy totals wait in RTC memory, so there is
+// nothing to redo. The RAM backlog does not survive: sleep waits for a
+// running sync, and records owed to an absent receiver are dropped.
+#define RTC_STATE_MAGIC    0x504F5354
+
+typedef struct {
+    uint32_t magic;
+    float offset_pitch, offset_roll;
+    float bias_p, bias_r;
+    bool vibration_enabled;
+    uint8_t tx_policy;
+    float tx_delta_deg;
+    uint8_t det_seq;
+    int64_t slept_at_us;   // System time, which the RTC keeps through deep sleep
+} rtc_state_t;
+
+static RTC_DATA_ATTR rtc_state_t rtc_state;
+
+static struct {
+    float pitch, roll;     // Where the stillness started
+    int64_t since_ms;
+} still;
+
+static int64_t system_time_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static bool power_not_worn(float pitch, float roll, int64_t now_ms) {
+    if (NOT_WORN_MS == 0) return false;
+    bool busy = radio_holds & (RADIO_HOLD_OTA | RADIO_HOLD_CAPTURE);
+    if (busy || act.state != ACT_SITTING
+        || fabsf(pitch - still.pitch) > NOT_WORN_DEG || fabsf(roll - still.roll) > NOT_WORN_DEG) {
+        still.pitch = pitch;
+        still.roll = roll;
+        still.since_ms = now_ms;
+        return false;
+    }
+    if (now_ms - still.since_ms < NOT_WORN_MS) return false;
+    xSemaphoreTake(backlog_lock, portMAX_DELAY);
+    bool syncing = link_up && sync_cursor < sync_end;
+    xSemaphoreGive(backlog_lock);
+    return !syncing;
+}
+
+// Accelerometer-only cycle mode, gyro in standby, motion interrupt latched
+// on INT: tens of uA while the C3 sleeps.
+static void mpu_arm_motion_wake(void) {
+    mpu_write(MPU_REG_ACCEL_CONFIG, 0x01);     // 5 Hz high-pass: motion, not gravity
+    mpu_write(MPU_REG_MOT_THR, MPU_MOTION_THR);
+    mpu_write(MPU_REG_MOT_DUR, 1);             // ms
+    mpu_write(MPU_REG_INT_PIN_CFG, 0x20);      // Active high, push-pull, held until read
+    mpu_write(MPU_REG_INT_ENABLE, 0x40);
+    vTaskDelay(pdMS_TO_TICKS(20));             // Let the high-pass settle
+    mpu_write(MPU_REG_PWR_MGMT_2, 0x47);       // Wake at 5 Hz, gyro axes in standby
+    mpu_write(MPU_REG_PWR_MGMT_1, 0x28);       // Cycle, temperature sensor off
+    uint8_t reg = MPU_REG_INT_STATUS, st;
+    i2c_master_write_read_device(0, MPU6050_ADDR, &reg, 1, &st, 1, 100);
+}
+
+static void power_deep_sleep(void) {
+    ESP_LOGI(TAG, "Not worn for %d s, sleeping until moved", NOT_WORN_MS / 1000);
+    if (!link_up) {
+        ESP_LOGW(TAG, "Dropping %lu unsynced records", (unsigned long)(backlog_head - sync_cursor));
+    }
+    rtc_state = (rtc_state_t) {
+        .magic = RTC_STATE_MAGIC,
+        .offset_pitch = offset_pitch, .offset_roll = offset_roll,
+        .bias_p = fusion.bias_p, .bias_r = fusion.bias_r,
+        .vibration_enabled = vibration_enabled,
+        .tx_policy = tx_policy, .tx_delta_deg = tx_delta_deg,
+        .det_seq = det_seq,
+        .slept_at_us = system_time_us(),
+    };
+    esp_timer_stop(haptic_timer);
+    gpio_set_level(VIB_MOTOR_PIN, 0);
+    gpio_set_level(LED_PIN, 1);                // Active low: off
+    gpio_hold_en(VIB_MOTOR_PIN);               // A floating driver base could run the motor
+    gpio_hold_en(LED_PIN);
+    gpio_deep_sleep_hold_en();
+    mpu_arm_motion_wake();
+    esp_deep_sleep_enable_gpio_wakeup(1ULL << MPU_INT_PIN, ESP_GPIO_WAKEUP_GPIO_HIGH);
+    esp_deep_sleep_start();
+}
+
+// Early in app_main, before the pins are set up. Returns true when waking
+// from a not-worn sleep with state to pick up.
+static bool power_resume(void) {
+    gpio_hold_dis(VIB_MOTOR_PIN);
+    gpio_hold_dis(LED_PIN);
+    if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_GPIO || rtc_state.magic != RTC_STATE_MAGIC) {
+        memset(&energy, 0, sizeof(energy));
+        rtc_state.magic = 0;
+        return false;
+    }
+    rtc_state.magic = 0;
+    offset_pitch = rtc_state.offset_pitch;
+    offset_roll = rtc_state.offset_roll;
+    fusion.bias_p = rtc_state.bias_p;
+    fusion.bias_r = rtc_state.bias_r;
+    vibration_enabled = rtc_state.vibration_enabled;
+    tx_policy = rtc_state.tx_policy;
+    tx_delta_deg = rtc_state.tx_delta_deg;
+    det_seq = rtc_state.det_seq;
+    int64_t slept_us = system_time_us() - rtc_state.slept_at_us;
+    if (slept_us > 0) energy.deep_us += slept_us;
+    energy.wakes++;
+    ESP_LOGI(TAG, "Moved after %lld s asleep, resuming", (long long)(slept_us / 1000000));
+    return true;
+}
+
+// --- OTA ---
+// The receiver streams the image in chunks. Each one is written straight to
+// the next OTA partition at its own offset, so chunks may land in any order
+// within the window; sectors are erased just ahead of the highest write.
+// The base (first missing chunk) is saved to NVS every OTA_SAVE_EVERY chunks
+// so an interrupted transfer resumes instead of starting over.
+typedef struct {
+    uint8_t src[6];
+    uint16_t len;
+    uint8_t data[sizeof(ota_chunk_t)];
+} ota_msg_t;
+
+typedef struct {
+    uint8_t sha256[32];
+    uint32_t size;
+    uint16_t base;
+    uint32_t erased_to;
+} ota_resume_t;
+
+static QueueHandle_t ota_queue;
+static struct {
+    bool active;
+    const esp_partition_t *part;
+    uint8_t peer[6];
+    ota_resume_t r;        // Image identity and progress, as saved
+    uint16_t chunks;
+    uint32_t sack;
+    uint16_t since_ack;
+    uint16_t saved_base;
+} ota;
+
+static void ota_save(void) {
+    nvs_handle_t h;
+    if (nvs_open("ota", NVS_READWRITE, &h) != ESP_OK) return;
+    nvs_set_blob(h, "resume", &ota.r, sizeof(ota.r));
+    nvs_commit(h);
+    nvs_close(h);
+    ota.saved_base = ota.r.base;
+}
+
+static void ota_forget(void) {
+    nvs_handle_t h;
+    if (nvs_open("ota", NVS_READWRITE, &h) != ESP_OK) return;
+    nvs_erase_key(h, "resume");
+    nvs_commit(h);
+    nvs_close(h);
+}
+
+static void ota_send_status(uint8_t status) {
+    ota_status_t st = { PKT_OTA_STATUS, status, ota.r.base, ota.sack };
+    frame_send(ota.peer, &st, sizeof(st));
+    ota.since_ack = 0;
+}
+
+// Unicast to the receiver during a transfer so acks get link-layer retries
+static void ota_use_peer(const uint8_t *mac) {
+    memcpy(ota.peer, mac, 6);
+    if (esp_now_is_peer_exist(mac)) return;
+    esp_now_peer_info_t peer = {};
+    memcpy(peer.peer_addr, mac, 6);
+    peer.channel = ESP_NOW_CHANNEL;
+    esp_now_add_peer(&peer);
+}
+
+static void ota_begin(const ota_begin_t *b) {
+    // A repeated BEGIN for the transfer in progress only needs the status again
+    if (ota.active && ota.r.size == b->size && memcmp(ota.r.sha256, b->sha256, 32) == 0) {
+        ota_send_status(OTA_ST_RECEIVING);
+        return;
+    }
+    ota.part = esp_ota_get_next_update_partition(NULL);
+    if (!ota.part || b->size == 0 || b->size > ota.part->size || b->size > 0xFFFFu * OTA_CHUNK) {
+        ESP_LOGE(TAG, "OTA: no room for %lu bytes", (unsigned long)b->size);
+        ota.active = false;
+        ota_send_status(OTA_ST_ERROR);
+        return;
+    }
+
+    // Same image as the saved resume point: carry on from there
+    ota_resume_t saved;
+    size_t len = sizeof(saved);
+    nvs_handle_t h;
+    bool resume = false;
+    if (nvs_open("ota", NVS_READONLY, &h) == ESP_OK) {
+        resume = nvs_get_blob(h, "resume", &saved, &len) == ESP_OK && len == sizeof(saved)
+                 && saved.size == b->size && memcmp(saved.sha256, b->sha256, 32) == 0;
+        nvs_close(h);
+    }
+    if (resume) {
+        ota.r = saved;
+    } else {
+        memcpy(ota.r.sha256, b->sha256, 32);
+        ota.r.size = b->size;
+        ota.r.base = 0;
+        ota.r.erased_to = 0;
+        ota_save();
+    }
+    ota.chunks = (b->size + OTA_CHUNK - 1) / OTA_CHUNK;
+    ota.sack = 0;
+    ota.saved_base = ota.r.base;
+    ota.active = true;
+    ESP_LOGI(TAG, "OTA: %lu bytes into %s, %s at chunk %u", (unsigned long)b->size, ota.part->label,
+             resume ? "resuming" : "starting", ota.r.base);
+    ota_send_status(OTA_ST_RECEIVING);
+}
+
+static void ota_chunk(const ota_chunk_t *c, int len) {
+    if (!ota.active || len < (int)offsetof(ota_chunk_t, data) + c->len || c->len > OTA_CHUNK) return;
+    if (c->index >= ota.chunks || esp_crc32_le(0, c->data, c->len) != c->crc) return;
+
+    int ahead = c->index - ota.r.base;      // 0 is the base, 1..32 map onto sack bits
+    bool have = ahead < 0 || (ahead > 0 && (ota.sack & (1u << (ahead - 1))));
+    if (ahead > OTA_WINDOW || have) {
+        if (++ota.since_ack >= OTA_ACK_EVERY) ota_send_status(OTA_ST_RECEIVING);
+        return;
+    }
+
+    uint32_t off = (uint32_t)c->index * OTA_CHUNK;
+    while (ota.r.erased_to < off + c->len) {
+        if (esp_partition_erase_range(ota.part, ota.r.erased_to, OTA_SECTOR) != ESP_OK) break;
+        ota.r.erased_to += OTA_SECTOR;
+    }
+    if (esp_partition_write(ota.part, off, c->data, c->len) != ESP_OK) {
+        ESP_LOGE(TAG, "OTA: flash write failed at %lu", (unsigned long)off);
+        ota.active = false;
+        ota_send_status(OTA_ST_ERROR);
+        return;
+    }
+
+    if (ahead > 0) {
+        ota.sack |= 1u << (ahead - 1);
+    } else {
+        // Slide past the base and everything contiguous behind it
+        ota.r.base++;
+        while (ota.sack & 1) {
+            ota.sack >>= 1;
+            ota.r.base++;
+        }
+        ota.sack >>= 1;
+        if (ota.r.base - ota.saved_base >= OTA_SAVE_EVERY) ota_save();
+    }
+
+    // Ack every few chunks, and straight away once a gap shows up so the
+    // receiver can fill it while the rest of the window is still arriving
+    if (++ota.since_ack >= OTA_ACK_EVERY || ota.r.base == ota.chunks || (ahead > 0 && ota.sack == 1u << (ahead - 1))) {
+        ota_send_status(OTA_ST_RECEIVING);
+    }
+}
+
+static bool ota_verify(void) {
+    static uint8_t buf[1024];
+    uint8_t sha[32];
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    for (uint32_t off = 0; off < ota.r.size; off += sizeof(buf)) {
+        uint32_t n = ota.r.size - off < sizeof(buf) ? ota.r.size - off : sizeof(buf);
+        if (esp_partition_read(ota.part, off, buf, n) != ESP_OK) {
+            mbedtls_sha256_free(&ctx);
+            return false;
+        }
+        mbedtls_sha256_update(&ctx, buf, n);
+    }
+    mbedtls_sha256_finish(&ctx, sha);
+    mbedtls_sha256_free(&ctx);
+    return memcmp(sha, ota.r.sha256, 32) == 0;
+}
+
+static void ota_finish(void) {
+    if (!ota.active) return;
+    if (ota.r.base < ota.chunks) {
+        ota_send_status(OTA_ST_RECEIVING);      // Not done yet, tell it what is missing
+        return;
+    }
+    ota.active = false;
+    ota_forget();
+    if (!ota_verify() || esp_ota_set_boot_partition(ota.part) != ESP_OK) {
+        ESP_LOGE(TAG, "OTA: image rejected");
+        ota_send_status(OTA_ST_ERROR);
+        return;
+    }
+    ESP_LOGI(TAG, "OTA: image verified, rebooting");
+    ota_send_status(OTA_ST_DONE);
+    vTaskDelay(pdMS_TO_TICKS(200));     // Let the status go out
+    esp_restart();
+}
+
+// Flash work stays out of the Wi-Fi task: on_recv only queues the frames
+static void ota_task(void *arg) {
+    static ota_msg_t m;
+    while (1) {
+        if (xQueueReceive(ota_queue, &m, pdMS_TO_TICKS(OTA_IDLE_MS)) != pdTRUE) {
+            if (ota.active) {
+                ota.active = false;
+                ota_save();
+                ESP_LOGW(TAG, "OTA: receiver went quiet at chunk %u, will resume", ota.r.base);
+                radio_hold(RADIO_HOLD_OTA, false);
+            }
+            continue;
+        }
+        ota_use_peer(m.src);
+        switch (m.data[0]) {
+            case CMD_OTA_BEGIN:
+                if (m.len == sizeof(ota_begin_t)) ota_begin((const ota_begin_t *) m.data);
+                break;
+            case CMD_OTA_DATA:
+                ota_chunk((const ota_chunk_t *) m.data, m.len);
+                break;
+            case CMD_OTA_END:
+                ota_finish();
+                break;
+            case CMD_OTA_ABORT:
+                if (ota.active) ota_save();
+                ota.active = false;
+                ota_send_status(OTA_ST_IDLE);
+                break;
+        }
+        radio_hold(RADIO_HOLD_OTA, ota.active);
+    }
+}
+
+static void ota_queue_frame(const uint8_t *src, const uint8_t *data, int len) {
+    static ota_msg_t m;    // Wi-Fi task only
+    if (len > (int) sizeof(m.data)) return;
+    memcpy(m.src, src, 6);
+    m.len = len;
+    memcpy(m.data, data, len);
+    xQueueSend(ota_queue, &m, 0);
+}
+
 // --- ESP-NOW CALLBACK ---
 static void on_recv(const esp_now_recv_info_t * info, const uint8_t * data, int len) {
-    if (len == sizeof(command_packet_t)) {
+    int64_t rx_us = esp_timer_get_time();
+    if (len < 1) return;
+    // Wearables broadcast; a receiver addresses its wearable alone
+    if (!memcmp(info->des_addr, BROADCAST_MAC, 6)) return;
+    int64_t now_ms = rx_us / 1000;
+    bool time_sync = len == sizeof(time_sync_t) && data[0] == CMD_TIME_SYNC;
+    if (!rx_paired && !time_sync) {     // A relay answers time requests too
+        memcpy(rx_mac, info->src_addr, 6);
+        rx_paired = true;
+        ESP_LOGI(TAG, "Paired with receiver %02x:%02x:%02x:%02x:%02x:%02x",
+                 rx_mac[0], rx_mac[1], rx_mac[2], rx_mac[3], rx_mac[4], rx_mac[5]);
+    }
+    bool from_rx = rx_paired && !memcmp(info->src_addr, rx_mac, 6);
+
+    if (time_sync) {
+        // Unpaired, only a relay hears us; its clock is the one to stamp
+        // for, the home box ignores stamps on relayed frames anyway
+        if (!from_rx && rx_paired) return;
+        time_sync_t r;
+        memcpy(&r, data, sizeof(r));
+        tsync_reply(&r, rx_us);
+        if (from_rx) link_last_ack_ms = rx_heard_ms = now_ms;
+        return;
+    }
+    if (!from_rx) return;
+    rx_heard_ms = now_ms;
+
+    if (data[0] >= CMD_OTA_BEGIN && data[0] <= CMD_OTA_ABORT) {
+        ota_queue_frame(info->src_addr, data, len);
+    }
+    else if (len == sizeof(backlog_ack_t) && data[0] == CMD_BACKLOG_ACK) {
+        backlog_ack_t ack;
+        memcpy(&ack, data, sizeof(ack));
+        backlog_acked_seq = ack.seq;
+        link_last_ack_ms = now_ms;
+        xTaskNotifyGive(sync_task);
+    }
+    else if (len == sizeof(command_packet_t)) {
         command_packet_t *cmd = (command_packet_t *)data;
-        if (cmd->command_id == 1) {
-            trigger_calibration = true; 
-        }
-        else if (cmd->command_id == 2) {
-            vibration_enabled = (cmd->value == 1);
-            gpio_set_level(LED_PIN, 0); vTaskDelay(50/portTICK_PERIOD_MS);
-            gpio_set_level(LED_PIN, 1);
+        detector_cfg_t c = detector_staged();
+        switch (cmd->command_id) {
+            case CMD_CALIBRATE:
+                trigger_calibration = true; 
+                break;
+            case CMD_VIBRATION:
+                vibration_enabled = (cmd->value == 1);
+                gpio_set_level(LED_PIN, 0); vTaskDelay(50/portTICK_PERIOD_MS);
+                gpio_set_level(LED_PIN, 1);
+                break;
+            case CMD_SET_ENTER_DEG:
+                c.enter_deg = cmd->value;
+                // Keep a band until the receiver's exit threshold follows
+                if (c.exit_deg >= c.enter_deg) c.exit_deg = c.enter_deg - 1;
+                detector_apply(&c);
+                break;
+            case CMD_SET_EXIT_DEG:
+                c.exit_deg = cmd->value;
+                detector_apply(&c);
+                break;
+            case CMD_SET_DWELL:
+                c.dwell_ms = cmd->value * 100;
+                detector_apply(&c);
+                break;
+            case CMD_SET_COOLDOWN:
+                c.cooldown_ms = cmd->value * 1000;
+                detector_apply(&c);
+                break;
+            case CMD_SET_TX_POLICY:
+                tx_policy = cmd->value <= TX_POLICY_BATCH ? cmd->value : TX_POLICY_EVENT;
+                break;
+            case CMD_SET_TX_DELTA:
+                if (cmd->value > 0) tx_delta_deg = cmd->value / 10.0f;
+                break;
+            case CMD_HEARTBEAT_ACK:
+                link_last_ack_ms = now_ms;
+                break;
+            case CMD_CAPTURE:
+            case CMD_CAPTURE_ODR:
+            case CMD_CAPTURE_DECIM:
+                capture_command(cmd->command_id, cmd->value);
+                break;
         }
     }
 }
@@ -109,8 +2189,11 @@ static void wifi_init_offline(void) {
 }
 
 static void init_esp_now(void) {
+    atomic_store(&frame_seq, esp_random());
     ESP_ERROR_CHECK(esp_now_init());
     ESP_ERROR_CHECK(esp_now_register_recv_cb(on_recv));
+    esp_now_register_send_cb(on_sent);
+    if (POWER_SAVE) esp_now_set_wake_window(RADIO_WAKE_WINDOW_MS);
 
     esp_now_peer_info_t peerInfo = {};
     memcpy(peerInfo.peer_addr, BROADCAST_MAC, 6);
@@ -120,27 +2203,55 @@ static void init_esp_now(void) {
 }
 
 void app_main(void) {
+    int64_t boot_us = boot_phase("app_main", 0);
+
+    // The sensor comes up in its own task while the radio starts here; the
+    // MPU's wake-up time overlaps the Wi-Fi/PHY init instead of adding to it.
+    xTaskCreate(sensor_init_task, "sensor_init", 3072, xTaskGetCurrentTaskHandle(), 5, NULL);
+
+    int64_t t = boot_us;
+    power_resume();
     nvs_flash_init();
+    detector_load();
     
     gpio_reset_pin(LED_PIN); gpio_set_direction(LED_PIN, GPIO_MODE_OUTPUT);
     gpio_reset_pin(VIB_MOTOR_PIN); gpio_set_direction(VIB_MOTOR_PIN, GPIO_MODE_OUTPUT); 
     gpio_reset_pin(BUTTON_PIN); gpio_set_direction(BUTTON_PIN, GPIO_MODE_INPUT);
     gpio_set_pull_mode(BUTTON_PIN, GPIO_PULLUP_ONLY);
 
-    i2c_init();
-    mpu_wake();
+    battery_init();
+    haptic_init();
+    backlog_lock = xSemaphoreCreateMutex();
+    xTaskCreate(backlog_sync_task, "backlog_sync", 3072, NULL, 4, &sync_task);
+    ota_queue = xQueueCreate(OTA_WINDOW + 8, sizeof(ota_msg_t));
+    xTaskCreate(ota_task, "ota", 4096, NULL, 3, NULL);
+    xTaskCreate(capture_task, "capture", 3072, NULL, 4, &capture_task_handle);
+    t = boot_phase("nvs/gpio/adc", t);
     wifi_init_offline();
+    power_init();
     init_esp_now();
+    boot_phase("radio", t);
 
+    if (!ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(2 * SENSOR_READY_MS))) {
+        ESP_LOGE(TAG, "Sensor init stuck");
+    }
+    boot_phase("ready", boot_us);
     ESP_LOGI(TAG, "Sender Ready.");
-    posture_packet_t packet;
-    
-    // Initialize packet with safe defaults
-    packet.pitch = 0; packet.roll = 0; packet.battery_level = 95;
 
     while (1) {
-        float raw_p, raw_r;
-        read_mpu_data(&raw_p, &raw_r);
+        PROF_START(loop_start);
+        imu_reading_t m;
+        int64_t now_us = esp_timer_get_time();
+        bool haptic = haptic_active(now_us);
+        if (!haptic) battery_update();      // Motor current would sag the reading
+        bool activity_changed = false;
+        if (read_mpu_data(&m)) {
+            reading_us = now_us;
+            fusion_update(&m, haptic, now_us);
+            // The motor's shake would read as movement
+            if (!haptic) activity_changed = activity_update(&m);
+        }
+        if (activity_changed) ESP_LOGI(TAG, "Activity -> %s", ACT_NAMES[act.state]);
 
         // --- CALIBRATION ---
         if (trigger_calibration || gpio_get_level(BUTTON_PIN) == 0) {
@@ -152,15 +2263,17 @@ void app_main(void) {
                 // 3-SECOND COUNTDOWN (With Keep-Alive)
                 for(int i=3; i>0; i--) {
                     // FIX: Send data during wait so receiver doesn't disconnect!
-                    esp_now_send(BROADCAST_MAC, (uint8_t *) &packet, sizeof(packet));
+                    send_heartbeat(tx_last_pitch, tx_last_roll);
                     
                     gpio_set_level(LED_PIN, 0); vTaskDelay(200 / portTICK_PERIOD_MS);
                     gpio_set_level(LED_PIN, 1); vTaskDelay(800 / portTICK_PERIOD_MS);
                 }
 
-                read_mpu_data(&raw_p, &raw_r);
-                offset_pitch = raw_p;
-                offset_roll = raw_r;
+                // Held still for 3 s: the gravity angles are the reference
+                if (read_mpu_data(&m)) fusion_reset(&m);
+                offset_pitch = fusion.pitch;
+                offset_roll = fusion.roll;
+                forecast_reset();
                 trigger_calibration = false; 
 
                 // Final confirmation
@@ -172,37 +2285,42 @@ void app_main(void) {
         }
 
         // --- DATA ---
-        float real_pitch = raw_p - offset_pitch;
-        float real_roll  = raw_r - offset_roll;
+        float real_pitch = fusion.pitch - offset_pitch;
+        float real_roll  = fusion.roll - offset_roll;
+
+        // --- DETECTION ---
+        // Tilting while walking, reaching or bending is not slouching
+        int64_t now_ms = esp_timer_get_time() / 1000;
+        bool moving = act.state == ACT_MOVING;
+        if (moving) {
+            det_pending_since = -1;
+            forecast_reset();
+        }
+        if (detector_take()) detector_save();
+        bool state_changed = !moving && detector_update(real_pitch, now_ms);
+        if (state_changed) {
+            send_event(real_pitch);
+            ESP_LOGI(TAG, "Posture -> %s (%.1f)", det_state == POSTURE_SLOUCH ? "SLOUCH" : "GOOD", real_pitch);
+        }
+
+        transmit(real_pitch, real_roll, state_changed, activity_changed, now_ms);
+        tsync_poll(esp_timer_get_time(), link_up);
+        backlog_log(real_pitch, real_roll, now_ms);
+        link_update(now_ms);
+        PROF_STOP(PROF_LOOP, loop_start);
+        prof_poll(now_ms);
 
         // --- FEEDBACK ---
-        if (fabs(real_pitch) > BAD_POSTURE_ANGLE) {
-            if (vibration_enabled) {
-                gpio_set_level(VIB_MOTOR_PIN, 1);
-            }
-            gpio_set_level(LED_PIN, 0); 
-            
-            packet.pitch = real_pitch;
-            packet.roll  = real_roll;
-            packet.battery_level = 95; 
-            esp_now_send(BROADCAST_MAC, (uint8_t *) &packet, sizeof(packet));
-
-            vTaskDelay(200 / portTICK_PERIOD_MS); // Blind time
-
-            gpio_set_level(VIB_MOTOR_PIN, 0);
-            gpio_set_level(LED_PIN, 1); 
-            vTaskDelay(50 / portTICK_PERIOD_MS); 
-        } 
-        else {
-            gpio_set_level(VIB_MOTOR_PIN, 0);
-            gpio_set_level(LED_PIN, 1); 
-
-            packet.pitch = real_pitch;
-            packet.roll  = real_roll;
-            packet.battery_level = 95; 
-            esp_now_send(BROADCAST_MAC, (uint8_t *) &packet, sizeof(packet));
-            
-            vTaskDelay(100 / portTICK_PERIOD_MS); 
-        }
-    }
-}
\ No newline at end of file
+        // The pulse runs off its own timer; the loop keeps sampling under it
+        bool nudge = !moving && forecast_update(real_pitch, now_ms);
+        if (!moving && detector_alert_due(now_ms)) haptic_pulse(HAPTIC_PULSE_MS);
+        else if (nudge) haptic_pulse(HAPTIC_NUDGE_MS);
+        gpio_set_level(LED_PIN, det_state == POSTURE_SLOUCH ? 0 : 1); 
+
+        // --- POWER ---
+        if (power_not_worn(real_pitch, real_roll, now_ms)) power_deep_sleep();
+        energy_tick(now_us);
+        energy_poll(now_ms);
+        vTaskDelay(ACT_PERIOD_MS[act.state] / portTICK_PERIOD_MS); 
+    }
+}